@@ -0,0 +1,2 @@
+/* native_sim feeds the dongle's curve from the ADC emulator, see app.overlay */
+#include "../nrf52840dongle_nrf52840/battery_def.h"
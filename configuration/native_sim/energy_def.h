@@ -0,0 +1,5 @@
+/* The nRF52840 figures of the dongle, so native_sim runs rank firmware
+ * changes the same way. CPU time is host time and only comparable between
+ * runs on the same machine.
+ */
+#include "../nrf52840dongle_nrf52840/energy_def.h"
@@ -0,0 +1,8 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* native_sim emulates the dongle's button and LEDs, see app.overlay */
+#include "../nrf52840dongle_nrf52840/led_state_def.h"
@@ -0,0 +1,25 @@
+#include "modules/battery.h"
+
+/* This configuration file is included only once from battery module and holds
+ * the discharge curve used to turn the supply voltage into a battery level.
+ */
+
+/* This structure enforces the header file is included only once in the build.
+ * Violating this requirement triggers a multiple definition error at link time.
+ */
+const struct {} battery_def_include_once;
+
+/* Supply voltage to level, highest voltage first, linear in between. Two
+ * alkaline cells in series, as measured on VDD. On USB power the dongle's
+ * regulator holds VDD at 3.0 V, which reads as full.
+ */
+static const struct battery_level_point battery_curve[] = {
+	{.mv = 3000, .level = 100},
+	{.mv = 2900, .level = 90},
+	{.mv = 2800, .level = 75},
+	{.mv = 2700, .level = 55},
+	{.mv = 2600, .level = 35},
+	{.mv = 2500, .level = 20},
+	{.mv = 2400, .level = 10},
+	{.mv = 2200, .level = 0},
+};
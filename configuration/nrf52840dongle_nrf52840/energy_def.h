@@ -0,0 +1,28 @@
+#include "modules/energy.h"
+
+/* This configuration file is included only once from energy module and holds
+ * the current model used to turn counted activity into charge.
+ */
+
+/* This structure enforces the header file is included only once in the build.
+ * Violating this requirement triggers a multiple definition error at link time.
+ */
+const struct {} energy_def_include_once;
+
+/* nRF52840 datasheet typicals at 3.0 V with the DC/DC converter, radio at
+ * 0 dBm on 1M PHY. Advertising events carry 31 bytes on three channels,
+ * about 3 x (380 us TX + 200 us RX + ramp-up). The LEDs are driven through
+ * their board resistors. Estimates to compare builds, not a substitute for a
+ * power analyzer; the USB peripheral powering the dongle is not included.
+ */
+static const struct energy_model energy_model = {
+	.cpu_active_ua = 3300,
+	.sleep_na = 3000,
+	.adv_event_nc = 10000,
+	.conn_event_nc = 2600,
+	.tx_pdu_nc = 2000,
+	.flash_write_nc = 1500,
+	.flash_byte_nc = 80,
+	/* In the order of enum led_id in led_state_def.h */
+	.led_ua = {2000, 1500, 1000, 1500},
+};
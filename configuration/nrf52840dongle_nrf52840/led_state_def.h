@@ -4,7 +4,9 @@
  * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
  */
 
-#include <caf/led_effect.h>
+#include <zephyr/drivers/gpio.h>
+
+#include "modules/led_state.h"
 
 /* This configuration file is included only once from led_state module and holds
  * information about LED effect associated with each state.
@@ -16,27 +18,59 @@
 const struct {} led_state_def_include_once;
 
 enum led_id {
-	LED_ID_0,
-	LED_ID_1,
+	LED_ID_LED1_GREEN,
+	LED_ID_LED2_RED,
+	LED_ID_LED2_BLUE,
+	LED_ID_LED2_GREEN,
 
 	LED_ID_COUNT
 };
 
-enum led_effect_id {
-	LED_EFFECT_ID_OFF,
-	LED_EFFECT_ID_BLINK,
-	LED_EFFECT_ID_BREATH,
-	LED_EFFECT_ID_CLOCK,
-
-	LED_EFFECT_ID_COUNT
+static const struct gpio_dt_spec led_gpio[LED_ID_COUNT] = {
+	[LED_ID_LED1_GREEN] = GPIO_DT_SPEC_GET_OR(DT_ALIAS(led0_green), gpios, {0}),
+	[LED_ID_LED2_RED] = GPIO_DT_SPEC_GET_OR(DT_ALIAS(led1_red), gpios, {0}),
+	[LED_ID_LED2_BLUE] = GPIO_DT_SPEC_GET_OR(DT_ALIAS(led1_blue), gpios, {0}),
+	[LED_ID_LED2_GREEN] = GPIO_DT_SPEC_GET_OR(DT_ALIAS(led1_green), gpios, {0}),
 };
 
-/* Map function to led effect */
-static const struct led_effect led_effect[] = {
-	[LED_EFFECT_ID_OFF] = LED_EFFECT_LED_OFF(),
-	[LED_EFFECT_ID_BLINK] = LED_EFFECT_LED_BLINK(200, LED_NOCOLOR()),
-	[LED_EFFECT_ID_BREATH] = LED_EFFECT_LED_BREATH(200, LED_NOCOLOR()),
-	[LED_EFFECT_ID_CLOCK] = LED_EFFECT_LED_CLOCK(3, LED_NOCOLOR()),
+#define LED_SHORT_BLINK_MS 300
+#define LED_LONG_BLINK_MS 1500
+#define LED_RESET_EFFECT_MS 2000
+
+struct led_state_effect {
+	/* Toggle period of the LED_PATTERN_BLINK LEDs, 0 when nothing blinks */
+	uint16_t blink_ms;
+	uint8_t pattern[LED_ID_COUNT];
 };
 
-static const struct led_effect led_effect_on = LED_EFFECT_LED_ON(LED_NOCOLOR());
+#define LED_STATE_EFFECT(_blink_ms, _led1, _red, _blue, _green)		\
+	{								\
+		.blink_ms = _blink_ms,					\
+		.pattern = {						\
+			[LED_ID_LED1_GREEN] = LED_PATTERN_##_led1,	\
+			[LED_ID_LED2_RED] = LED_PATTERN_##_red,		\
+			[LED_ID_LED2_BLUE] = LED_PATTERN_##_blue,	\
+			[LED_ID_LED2_GREEN] = LED_PATTERN_##_green,	\
+		},							\
+	}
+
+/* Map device state to led effect, see the status table in README.md */
+static const struct led_state_effect led_state_effect[LED_STATE_COUNT] = {
+	[LED_STATE_ADV_ON_DISCONNECTED] =
+		LED_STATE_EFFECT(LED_SHORT_BLINK_MS, BLINK, OFF, ON, OFF),
+	[LED_STATE_ADV_OFF_DISCONNECTED] =
+		LED_STATE_EFFECT(LED_LONG_BLINK_MS, BLINK, OFF, OFF, OFF),
+	[LED_STATE_ADV_ON_CONNECTED] =
+		LED_STATE_EFFECT(LED_SHORT_BLINK_MS, BLINK, ON, OFF, OFF),
+	[LED_STATE_ADV_OFF_CONNECTED] =
+		LED_STATE_EFFECT(LED_LONG_BLINK_MS, BLINK, ON, OFF, OFF),
+	[LED_STATE_ADV_ON_DISCONNECTED_BONDED] =
+		LED_STATE_EFFECT(LED_SHORT_BLINK_MS, BLINK, OFF, BLINK, OFF),
+	[LED_STATE_ADV_OFF_DISCONNECTED_BONDED] =
+		LED_STATE_EFFECT(LED_LONG_BLINK_MS, BLINK, OFF, BLINK, OFF),
+	[LED_STATE_ADV_ON_CONNECTED_BONDED] =
+		LED_STATE_EFFECT(LED_SHORT_BLINK_MS, BLINK, ON, OFF, OFF),
+	[LED_STATE_ADV_OFF_CONNECTED_BONDED] =
+		LED_STATE_EFFECT(LED_LONG_BLINK_MS, BLINK, ON, OFF, OFF),
+	[LED_STATE_RESET] = LED_STATE_EFFECT(0, ON, ON, ON, ON),
+};
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Battery sampling and notification rates on the native_sim build.
+
+Drives the ADC emulator through each scripted supply curve with the
+"battery_sim curve" shell command and reads, once the curve has run its
+course, how many ADC bursts and samples were taken and how many level
+updates reached the Battery Service, per hour:
+
+    sudo btvirt -l2
+    west build -b native_sim -t bench_battery
+
+The firmware runs with -no-rt, so a day of simulated time passes in
+seconds. Update counts are the notifications a subscribed central would
+get; the sample counts include the hardware oversampling of the channel.
+"""
+
+import argparse
+import asyncio
+import re
+import sys
+
+from bench_central import new_report, shell, start_firmware, write_report
+
+CURVES = ("flat", "discharge", "noisy")
+
+TOTALS_RE = re.compile(
+    r"(\d+) bursts, (\d+) samples, (\d+) updates, (\d+) errors in (\d+) s")
+RATES_RE = re.compile(
+    r"per hour: ([\d.]+) bursts, ([\d.]+) samples, ([\d.]+) updates")
+LEVEL_RE = re.compile(r"level (\d+) %, reported (-?\d+) %, filtered (\d+) mV")
+
+
+async def run_curve(args, proc, curve):
+    await shell(proc, f"battery_sim curve {curve} {args.hours}",
+                [re.compile("Curve")], args.timeout)
+    await shell(proc, "battery reset", [re.compile("reset")], args.timeout)
+
+    while True:
+        level, totals, rates = await shell(
+            proc, "battery show", [LEVEL_RE, TOTALS_RE, RATES_RE],
+            args.timeout)
+        if int(totals.group(5)) >= args.hours * 3600:
+            break
+        await asyncio.sleep(args.poll_s)
+
+    bursts, samples, updates, errors, seconds = (
+        int(v) for v in totals.groups())
+    return {
+        "simulated_s": seconds,
+        "bursts": bursts,
+        "samples": samples,
+        "updates": updates,
+        "errors": errors,
+        "per_hour": {
+            "bursts": float(rates.group(1)),
+            "samples": float(rates.group(2)),
+            "notifications": float(rates.group(3)),
+        },
+        "final_level": int(level.group(1)),
+        "final_mv": int(level.group(3)),
+    }
+
+
+async def run(args):
+    proc = await start_firmware(args.exe, args.peripheral_hci, "-no-rt")
+
+    try:
+        return {curve: await run_curve(args, proc, curve)
+                for curve in args.curves}
+    finally:
+        proc.terminate()
+        await proc.wait()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", required=True, help="native_sim zephyr.exe")
+    parser.add_argument("--output", help="JSON result file, default stdout")
+    parser.add_argument("--peripheral-hci", default="hci0")
+    parser.add_argument("--curves", nargs="+", choices=CURVES,
+                        default=list(CURVES))
+    parser.add_argument("--hours", type=int, default=24,
+                        help="simulated length of each curve")
+    parser.add_argument("--poll-s", type=float, default=0.5,
+                        help="wall time between readouts")
+    parser.add_argument("--timeout", type=float, default=60.0)
+    args = parser.parse_args()
+
+    report = new_report()
+    try:
+        report["results"] = asyncio.run(run(args))
+    except (RuntimeError, asyncio.TimeoutError, ValueError) as e:
+        report["error"] = str(e) or type(e).__name__
+
+    write_report(report, args.output)
+    return 1 if "error" in report else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
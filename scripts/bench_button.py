@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Button latency and idle load benchmark for the native_sim build.
+
+Clicks the emulated button through the "button click" shell command and
+reads the press to click event latency from the trace, then leaves the
+firmware idle for a sampling period and reads its CPU load. Build once per
+button backend and compare the results:
+
+    sudo btvirt -l2
+    west build -b native_sim -t bench_button
+    west build -b native_sim -t bench_button -- \\
+        -DEXTRA_CONF_FILE=overlay-button-irq.conf
+
+Short clicks are reported on release, so the hold time is taken off the
+click latency. The idle CPU load stands in for the idle current, which
+needs a power analyzer on the dongle: an idle backend wakes nothing.
+"""
+
+import argparse
+import asyncio
+import re
+import sys
+
+from bench_central import new_report, shell, start_firmware, write_report
+
+CLICK_RE = re.compile(r"\bclick\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)")
+CPU_RE = re.compile(r"cpu (\d+)\.(\d)% over (\d+) ms")
+
+
+async def run(args):
+    proc = await start_firmware(args.exe, args.peripheral_hci)
+
+    try:
+        await shell(proc, "trace reset", [re.compile("Trace reset")],
+                    args.timeout)
+        for _ in range(args.clicks):
+            await shell(proc, f"button click {args.hold_ms}",
+                        [re.compile("Clicked")], args.timeout)
+            # Past the double click time, each click is a short one
+            await asyncio.sleep(args.gap_ms / 1000.0)
+
+        [click] = await shell(proc, "trace show", [CLICK_RE], args.timeout)
+        count, lo, avg, hi, p99 = (int(v) for v in click.groups())
+        hold_us = args.hold_ms * 1000
+
+        # Start a sampling period now, the last one before the readout
+        # holds no clicks as long as --idle-s is over the period
+        await shell(proc, "stats sample", [re.compile("Sampling")],
+                    args.timeout)
+        await asyncio.sleep(args.idle_s)
+        [cpu] = await shell(proc, "stats show", [CPU_RE], args.timeout)
+        whole, tenth, period = (int(v) for v in cpu.groups())
+
+        return {
+            "clicks": count,
+            "press_to_click_us": {
+                "min": lo - hold_us,
+                "avg": avg - hold_us,
+                "max": hi - hold_us,
+                "p99": p99 - hold_us,
+            },
+            "idle_cpu_load_pct": whole + tenth / 10.0,
+            "idle_period_ms": period,
+        }
+    finally:
+        proc.terminate()
+        await proc.wait()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", required=True, help="native_sim zephyr.exe")
+    parser.add_argument("--backend", required=True,
+                        help="button backend of the build, for the report")
+    parser.add_argument("--output", help="JSON result file, default stdout")
+    parser.add_argument("--peripheral-hci", default="hci0")
+    parser.add_argument("--clicks", type=int, default=20)
+    parser.add_argument("--hold-ms", type=int, default=50)
+    parser.add_argument("--gap-ms", type=int, default=1000)
+    parser.add_argument("--idle-s", type=float, default=10.0)
+    parser.add_argument("--timeout", type=float, default=30.0)
+    args = parser.parse_args()
+
+    report = new_report(backend=args.backend)
+    try:
+        report["results"] = asyncio.run(run(args))
+    except (RuntimeError, asyncio.TimeoutError, ValueError) as e:
+        report["error"] = str(e) or type(e).__name__
+
+    write_report(report, args.output)
+    return 1 if "error" in report else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
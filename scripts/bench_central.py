@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+"""Scripted central benchmark for the native_sim build.
+
+Starts zephyr.exe on one HCI controller and drives it as a central from
+another one, e.g. a pair of BlueZ virtual controllers:
+
+    sudo btvirt -l2          # creates hci0 and hci1, linked over the air
+    west build -b native_sim -t bench
+
+The firmware needs CONFIG_APP_BPS_BENCH_BURST (set in
+configuration/native_sim/board.conf) so that subscribing starts a burst of
+measurements. Results are written as one JSON object, to be kept per commit.
+
+With --centrals it instead measures the aggregate throughput of several
+centrals connected at once, one per adapter, e.g. for 1, 2 and 4:
+
+    sudo btvirt -l5
+    west build -t bench_multi
+
+The burst goes to every connected central, the ones that subscribe after
+the first may miss its start. The aggregate counts what arrived.
+"""
+
+import argparse
+import asyncio
+import contextlib
+import json
+import os
+import subprocess
+import sys
+import time
+
+from bleak import BleakClient, BleakScanner
+
+BPM_UUID = "00002a35-0000-1000-8000-00805f9b34fb"
+DEVICE_NAME = "Nordic_BPS_Peripheral"
+
+
+def now_ms():
+    return time.monotonic() * 1000.0
+
+
+def git_commit():
+    try:
+        return subprocess.check_output(
+            ["git", "rev-parse", "HEAD"], text=True,
+            cwd=os.path.dirname(os.path.abspath(__file__))).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+async def wait_for_adv(adapter, timeout, address=None):
+    """Find the peripheral by name, or by address once bonded: directed
+    advertising carries no advertising data, so no name."""
+    if address:
+        device = await BleakScanner.find_device_by_address(
+            address, timeout=timeout, adapter=adapter)
+    else:
+        device = await BleakScanner.find_device_by_name(
+            DEVICE_NAME, timeout=timeout, adapter=adapter)
+    if device is None:
+        raise RuntimeError(f"{address or DEVICE_NAME} not advertising")
+    return device
+
+
+async def start_firmware(exe, hci, *options):
+    """zephyr.exe on an empty flash, its shell on stdin/stdout."""
+    return await asyncio.create_subprocess_exec(
+        exe, f"--bt-dev={hci}", "-flash_rm", "-uart_stdinout", *options,
+        stdin=asyncio.subprocess.PIPE, stdout=asyncio.subprocess.PIPE)
+
+
+async def shell(proc, command, patterns, timeout):
+    """Send a command, return the match of each pattern in order."""
+    proc.stdin.write((command + "\n").encode())
+    await proc.stdin.drain()
+    matches = []
+    while len(matches) < len(patterns):
+        line = await asyncio.wait_for(proc.stdout.readline(), timeout)
+        if not line:
+            raise RuntimeError(f"firmware exited during '{command}'")
+        match = patterns[len(matches)].search(line.decode(errors="replace"))
+        if match:
+            matches.append(match)
+    return matches
+
+
+def new_report(**fields):
+    """Commit, board and time, then the given fields."""
+    return {
+        "commit": git_commit(),
+        "board": "native_sim",
+        "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        **fields,
+    }
+
+
+def write_report(report, output):
+    """Print the report, and write it to the output file if there is one."""
+    text = json.dumps(report, indent=2)
+    if output:
+        with open(output, "w") as f:
+            f.write(text + "\n")
+    print(text)
+
+
+async def run(args):
+    results = {}
+    exe = subprocess.Popen(
+        [args.exe, f"--bt-dev={args.peripheral_hci}", "-flash_rm"],
+        stdout=subprocess.DEVNULL if not args.verbose else None)
+    started = now_ms()
+
+    try:
+        adapter = args.central_hci[0]
+        device = await wait_for_adv(adapter, args.timeout)
+        results["boot_to_adv_ms"] = round(now_ms() - started, 1)
+        if args.boot_budget_ms and \
+                results["boot_to_adv_ms"] > args.boot_budget_ms:
+            results["boot_budget_exceeded"] = True
+
+        received = []
+        done = asyncio.Event()
+
+        def on_bpm(_, data):
+            received.append(now_ms())
+            if len(received) >= args.burst:
+                done.set()
+
+        async with BleakClient(device, adapter=adapter) as client:
+            connected = now_ms()
+            await client.start_notify(BPM_UUID, on_bpm)
+            try:
+                await asyncio.wait_for(done.wait(), args.timeout)
+            except asyncio.TimeoutError:
+                pass
+            await client.stop_notify(BPM_UUID)
+
+        if not received:
+            raise RuntimeError("no measurement received")
+
+        results["connect_to_first_notification_ms"] = round(
+            received[0] - connected, 1)
+        results["notifications"] = len(received)
+        span = max(received[-1] - received[0], 1.0)
+        results["throughput_records_per_s"] = round(
+            (len(received) - 1) * 1000.0 / span, 1)
+
+        # The peripheral advertises again on its own after the disconnect
+        disconnected = now_ms()
+        device = await wait_for_adv(adapter, args.timeout, device.address)
+        async with BleakClient(device, adapter=adapter):
+            results["reconnect_ms"] = round(now_ms() - disconnected, 1)
+    finally:
+        exe.terminate()
+        exe.wait()
+
+    return results
+
+
+async def wait_quiet(received, quiet_ms, timeout):
+    """Until notifications stopped coming for quiet_ms, or the timeout."""
+    deadline = now_ms() + timeout * 1000.0
+    while now_ms() < deadline:
+        last = max((r[-1] for r in received if r), default=None)
+        if last is not None and now_ms() - last > quiet_ms:
+            return
+        await asyncio.sleep(quiet_ms / 4000.0)
+
+
+async def run_centrals(args, count):
+    received = [[] for _ in range(count)]
+    exe = subprocess.Popen(
+        [args.exe, f"--bt-dev={args.peripheral_hci}", "-flash_rm"],
+        stdout=subprocess.DEVNULL if not args.verbose else None)
+
+    try:
+        async with contextlib.AsyncExitStack() as stack:
+            clients = []
+            # The peripheral keeps advertising for the next central
+            for adapter in args.central_hci[:count]:
+                device = await wait_for_adv(adapter, args.timeout)
+                clients.append(await stack.enter_async_context(
+                    BleakClient(device, adapter=adapter)))
+
+            for client, times in zip(clients, received):
+                await client.start_notify(
+                    BPM_UUID, lambda _, data, t=times: t.append(now_ms()))
+            await wait_quiet(received, args.quiet_ms, args.timeout)
+    finally:
+        exe.terminate()
+        exe.wait()
+
+    times = sorted(t for r in received for t in r)
+    if not times:
+        raise RuntimeError(f"no measurement received by {count} centrals")
+    span = max(times[-1] - times[0], 1.0)
+    return {
+        "notifications": [len(r) for r in received],
+        "aggregate_records_per_s": round((len(times) - 1) * 1000.0 / span, 1),
+    }
+
+
+async def run_multi(args):
+    if max(args.centrals) > len(args.central_hci):
+        raise RuntimeError(f"{max(args.centrals)} centrals need as many "
+                           f"--central-hci adapters")
+    return {str(count): await run_centrals(args, count)
+            for count in args.centrals}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", required=True, help="native_sim zephyr.exe")
+    parser.add_argument("--output", help="JSON result file, default stdout")
+    parser.add_argument("--peripheral-hci", default="hci0")
+    parser.add_argument("--central-hci", nargs="+", default=["hci1"],
+                        help="one adapter per central")
+    parser.add_argument("--centrals", nargs="+", type=int,
+                        help="aggregate throughput for these numbers of "
+                             "centrals instead")
+    parser.add_argument("--quiet-ms", type=float, default=1000.0,
+                        help="end of a multi central burst")
+    parser.add_argument("--burst", type=int, default=500,
+                        help="CONFIG_APP_BPS_BENCH_BURST of the build")
+    parser.add_argument("--timeout", type=float, default=30.0)
+    parser.add_argument("--boot-budget-ms", type=float, default=0,
+                        help="fail if boot to advertising takes longer")
+    parser.add_argument("--verbose", action="store_true",
+                        help="show the firmware log")
+    args = parser.parse_args()
+
+    report = new_report()
+    try:
+        report["results"] = asyncio.run(
+            run_multi(args) if args.centrals else run(args))
+    except RuntimeError as e:
+        report["error"] = str(e)
+
+    if report.get("results", {}).get("boot_budget_exceeded"):
+        report["error"] = (f"boot to advertising over the "
+                           f"{args.boot_budget_ms:g} ms budget")
+
+    write_report(report, args.output)
+    return 1 if "error" in report else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
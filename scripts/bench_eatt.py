@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""Live measurement latency during a bulk history transfer, native_sim.
+
+Fills the record store, connects and pairs, then for each bearer mode
+measures the time from a "bps measure" shell command to the Blood Pressure
+Measurement notification, first on an idle link and then while the bulk
+history service streams the whole store. "eatt" keeps live values on the
+enhanced bearers and the history on the unenhanced one, "legacy" puts
+everything on the unenhanced bearer as without EATT. Same setup as
+bench_central.py, plus EATT on the BlueZ side:
+
+    sudo btvirt -l2
+    echo 1 | sudo tee /sys/module/bluetooth/parameters/enable_ecred
+    # /etc/bluetooth/main.conf: [GATT] Channels=3, then restart bluetoothd
+    west build -b native_sim -t bench_eatt
+
+Without enhanced bearers both modes run on the unenhanced bearer and the
+report says so.
+"""
+
+import argparse
+import asyncio
+import re
+import struct
+import sys
+
+from bleak import BleakClient
+
+from bench_central import (new_report, now_ms, start_firmware, wait_for_adv,
+                           write_report)
+from history_decode import Transfer
+
+BPM_UUID = "00002a35-0000-1000-8000-00805f9b34fb"
+HISTORY_DATA_UUID = "8d1b0001-4c7e-4b7b-9a3e-2b5f3c6d7e80"
+HISTORY_CTRL_UUID = "8d1b0002-4c7e-4b7b-9a3e-2b5f3c6d7e80"
+
+BEARERS_RE = re.compile(r"(\d+) enhanced bearers")
+
+
+class Firmware:
+    """zephyr.exe with its shell on stdin/stdout."""
+
+    def __init__(self, proc):
+        self.proc = proc
+        self.lines = asyncio.Queue()
+        self.reader = asyncio.create_task(self._read())
+
+    async def _read(self):
+        while True:
+            line = await self.proc.stdout.readline()
+            await self.lines.put(line)
+            if not line:
+                return
+
+    def send(self, command):
+        self.proc.stdin.write((command + "\n").encode())
+
+    async def command(self, command, pattern, timeout):
+        while not self.lines.empty():
+            self.lines.get_nowait()
+        self.send(command)
+        await self.proc.stdin.drain()
+        while True:
+            line = await asyncio.wait_for(self.lines.get(), timeout)
+            if not line:
+                raise RuntimeError(f"firmware exited during '{command}'")
+            match = re.search(pattern, line.decode(errors="replace"))
+            if match:
+                return match
+
+
+def summary(samples):
+    if not samples:
+        return None
+    s = sorted(samples)
+    return {
+        "count": len(s),
+        "min_ms": round(s[0], 1),
+        "p50_ms": round(s[len(s) // 2], 1),
+        "p99_ms": round(s[min(len(s) - 1, len(s) * 99 // 100)], 1),
+        "max_ms": round(s[-1], 1),
+    }
+
+
+class Live:
+    def __init__(self, fw):
+        self.fw = fw
+        self.arrived = asyncio.Event()
+        self.last = now_ms()
+
+    def on_bpm(self, _, data):
+        self.last = now_ms()
+        self.arrived.set()
+
+    async def sample(self, timeout):
+        self.arrived.clear()
+        started = now_ms()
+        self.fw.send("bps measure")
+        await asyncio.wait_for(self.arrived.wait(), timeout)
+        return now_ms() - started
+
+
+async def bulk(client, timeout):
+    transfer = Transfer()
+    done = asyncio.Event()
+
+    def on_chunk(_, data):
+        transfer.feed(bytes(data))
+        if transfer.done:
+            done.set()
+
+    await client.start_notify(HISTORY_DATA_UUID, on_chunk)
+    started = now_ms()
+    await client.write_gatt_char(HISTORY_CTRL_UUID,
+                                 struct.pack("<BIH", 0x01, 0, 0), True)
+    await asyncio.wait_for(done.wait(), timeout)
+    ended = now_ms()
+    await client.stop_notify(HISTORY_DATA_UUID)
+    return len(transfer.records), ended - started
+
+
+async def run_mode(args, fw, client, live, mode):
+    await fw.command(f"eatt legacy {'on' if mode == 'legacy' else 'off'}",
+                     "Legacy only", args.timeout)
+
+    idle = []
+    for _ in range(args.samples):
+        idle.append(await live.sample(args.timeout))
+        await asyncio.sleep(args.interval_ms / 1000.0)
+
+    transfer = asyncio.create_task(bulk(client, args.timeout))
+    busy = []
+    while not transfer.done():
+        busy.append(await live.sample(args.timeout))
+        await asyncio.sleep(args.interval_ms / 1000.0)
+    records, sync_ms = await transfer
+
+    return {
+        "idle": summary(idle),
+        "during_bulk": summary(busy),
+        "bulk_records": records,
+        "bulk_sync_ms": round(sync_ms, 1),
+    }
+
+
+async def run(args):
+    proc = await start_firmware(args.exe, args.peripheral_hci)
+    fw = Firmware(proc)
+
+    try:
+        await fw.command(f"history fill {args.records}", "Appended",
+                         args.timeout)
+        device = await wait_for_adv(args.central_hci, args.timeout)
+        async with BleakClient(device, adapter=args.central_hci) as client:
+            await client.pair()
+            live = Live(fw)
+            await client.start_notify(BPM_UUID, live.on_bpm)
+            # Let the benchmark burst that follows the subscription drain
+            while now_ms() - live.last < 1000:
+                await asyncio.sleep(0.25)
+
+            bearers = int((await fw.command(
+                "eatt show", BEARERS_RE.pattern, args.timeout)).group(1))
+            results = {"enhanced_bearers": bearers}
+            for mode in ("eatt", "legacy"):
+                results[mode] = await run_mode(args, fw, client, live, mode)
+            await client.stop_notify(BPM_UUID)
+            return results
+    finally:
+        proc.terminate()
+        await proc.wait()
+        fw.reader.cancel()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", required=True, help="native_sim zephyr.exe")
+    parser.add_argument("--output", help="JSON result file, default stdout")
+    parser.add_argument("--peripheral-hci", default="hci0")
+    parser.add_argument("--central-hci", default="hci1")
+    parser.add_argument("--records", type=int, default=5000,
+                        help="records in the bulk transfer")
+    parser.add_argument("--samples", type=int, default=20,
+                        help="live measurements on the idle link")
+    parser.add_argument("--interval-ms", type=int, default=100)
+    parser.add_argument("--timeout", type=float, default=600.0)
+    args = parser.parse_args()
+
+    report = new_report()
+    try:
+        report["results"] = asyncio.run(run(args))
+    except (RuntimeError, asyncio.TimeoutError, ValueError) as e:
+        report["error"] = str(e) or type(e).__name__
+
+    if report.get("results", {}).get("enhanced_bearers") == 0:
+        report["note"] = "no enhanced bearers, both modes shared one bearer"
+
+    write_report(report, args.output)
+    return 1 if "error" in report else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""History download benchmark for the native_sim build.
+
+Fills the record store through the "history fill" shell command, then reads
+it back twice over the same link: as Blood Pressure Measurement
+notifications through the RACP, and as delta encoded chunks from the bulk
+history service. Reports the time and the bytes on air for each, per record
+count, as one JSON object. Same setup as bench_central.py:
+
+    sudo btvirt -l2
+    west build -b native_sim -t bench_history
+
+The 10k run needs a settings partition of about 250 KB on native_sim.
+"""
+
+import argparse
+import asyncio
+import re
+import struct
+import sys
+
+from bleak import BleakClient
+
+from bench_central import (DEVICE_NAME, new_report, now_ms, shell,
+                           start_firmware, wait_for_adv, write_report)
+from history_decode import Transfer
+
+BPM_UUID = "00002a35-0000-1000-8000-00805f9b34fb"
+RACP_UUID = "00002a52-0000-1000-8000-00805f9b34fb"
+HISTORY_DATA_UUID = "8d1b0001-4c7e-4b7b-9a3e-2b5f3c6d7e80"
+HISTORY_CTRL_UUID = "8d1b0002-4c7e-4b7b-9a3e-2b5f3c6d7e80"
+
+# ATT notification and L2CAP headers, then per LL PDU on 1M PHY: preamble,
+# access address, header, MIC and CRC
+ATT_L2CAP_HDR = 3 + 4
+LL_PDU_OVERHEAD = 14
+LL_MAX_PAYLOAD = 251
+
+
+def on_air(value_len):
+    sdu = value_len + ATT_L2CAP_HDR
+    pdus = -(-sdu // LL_MAX_PAYLOAD)
+    return sdu + pdus * LL_PDU_OVERHEAD
+
+
+class Tally:
+    def __init__(self):
+        self.notifications = 0
+        self.payload = 0
+        self.air = 0
+        self.last = now_ms()
+
+    def add(self, data):
+        self.notifications += 1
+        self.payload += len(data)
+        self.air += on_air(len(data))
+        self.last = now_ms()
+
+    def result(self, records, started, ended):
+        return {
+            "records": records,
+            "sync_ms": round(ended - started, 1),
+            "notifications": self.notifications,
+            "payload_bytes": self.payload,
+            "bytes_on_air": self.air,
+            "bytes_on_air_per_record": round(self.air / max(records, 1), 2),
+        }
+
+
+async def quiet(tally, ms):
+    """Let the CCC burst and the demo measurement drain first."""
+    while now_ms() - tally.last < ms:
+        await asyncio.sleep(ms / 4000.0)
+
+
+async def plain(client, timeout):
+    tally = [Tally()]
+    done = asyncio.Event()
+
+    await client.start_notify(BPM_UUID, lambda _, d: tally[0].add(d))
+    await client.start_notify(RACP_UUID, lambda _, d: done.set())
+    await quiet(tally[0], 1000)
+
+    tally[0] = Tally()
+    started = now_ms()
+    await client.write_gatt_char(RACP_UUID, bytes([0x01, 0x01]), True)
+    await asyncio.wait_for(done.wait(), timeout)
+    ended = now_ms()
+
+    await client.stop_notify(RACP_UUID)
+    await client.stop_notify(BPM_UUID)
+    return tally[0].result(tally[0].notifications, started, ended)
+
+
+async def bulk(client, timeout):
+    tally = Tally()
+    transfer = Transfer()
+    done = asyncio.Event()
+
+    def on_chunk(_, data):
+        tally.add(data)
+        transfer.feed(bytes(data))
+        if transfer.done:
+            done.set()
+
+    await client.start_notify(HISTORY_DATA_UUID, on_chunk)
+    started = now_ms()
+    await client.write_gatt_char(HISTORY_CTRL_UUID,
+                                 struct.pack("<BIH", 0x01, 0, 0), True)
+    await asyncio.wait_for(done.wait(), timeout)
+    ended = now_ms()
+    await client.stop_notify(HISTORY_DATA_UUID)
+    return tally.result(len(transfer.records), started, ended)
+
+
+async def run_one(args, count):
+    proc = await start_firmware(args.exe, args.peripheral_hci)
+
+    try:
+        await shell(proc, f"history fill {count}", [re.compile("Appended")],
+                    args.timeout)
+        device = await wait_for_adv(args.central_hci, args.timeout)
+        async with BleakClient(device, adapter=args.central_hci) as client:
+            await client.pair()
+            return {
+                "bpm_racp": await plain(client, args.timeout),
+                "history_svc": await bulk(client, args.timeout),
+            }
+    finally:
+        proc.terminate()
+        await proc.wait()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", required=True, help="native_sim zephyr.exe")
+    parser.add_argument("--output", help="JSON result file, default stdout")
+    parser.add_argument("--peripheral-hci", default="hci0")
+    parser.add_argument("--central-hci", default="hci1")
+    parser.add_argument("--counts", default="1000,10000",
+                        help="comma separated record counts")
+    parser.add_argument("--timeout", type=float, default=600.0)
+    args = parser.parse_args()
+
+    report = new_report(device=DEVICE_NAME, results={})
+    try:
+        for count in (int(c) for c in args.counts.split(",")):
+            report["results"][str(count)] = asyncio.run(run_one(args, count))
+    except (RuntimeError, asyncio.TimeoutError, ValueError) as e:
+        report["error"] = str(e) or type(e).__name__
+
+    write_report(report, args.output)
+    return 1 if "error" in report else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
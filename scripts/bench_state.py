@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Flash writes caused by state changes, native_sim.
+
+Toggles advertising thousands of times with "app_state stress", the same
+path a short click takes, waits out the write-behind quiet period and
+checks the settings writes that resulted: none after an even number of
+toggles, as the state ends where it started, and one after an odd number.
+Runs that outlast CONFIG_APP_STATE_SAVE_MAX_DELAY_MS may add one forced
+write per period. Fails with exit code 1 if more writes happened:
+
+    sudo btvirt -l2
+    west build -b native_sim -t bench_state
+"""
+
+import argparse
+import asyncio
+import re
+import sys
+import time
+
+from bench_central import new_report, shell, start_firmware, write_report
+
+COUNTS_RE = re.compile(r"(\d+) updates, (\d+) writes, (\d+) avoided")
+LATENCY_RE = re.compile(r"write us avg (\d+) max (\d+)")
+
+
+async def counters(proc, timeout):
+    counts, latency = await shell(proc, "app_state show",
+                                  [COUNTS_RE, LATENCY_RE], timeout)
+    updates, writes, _ = (int(v) for v in counts.groups())
+    return updates, writes, [int(v) for v in latency.groups()]
+
+
+async def scenario(args, proc, toggles):
+    updates0, writes0, _ = await counters(proc, args.timeout)
+
+    started = time.monotonic()
+    await shell(proc, f"app_state stress {toggles} {args.gap_ms}",
+                [re.compile("Toggled")], toggles * 0.1 + args.timeout)
+    stress_ms = (time.monotonic() - started) * 1000
+    await asyncio.sleep((args.save_delay_ms + args.margin_ms) / 1000.0)
+
+    updates, writes, (avg_us, max_us) = await counters(proc, args.timeout)
+    expected = toggles % 2
+    allowed = expected + int(stress_ms // args.max_delay_ms)
+    return {
+        "toggles": toggles,
+        "stress_ms": round(stress_ms),
+        "updates": updates - updates0,
+        "writes": writes - writes0,
+        "expected_writes": expected,
+        "allowed_writes": allowed,
+        "write_avg_us": avg_us,
+        "write_max_us": max_us,
+        "pass": writes - writes0 <= allowed,
+    }
+
+
+async def run(args):
+    proc = await start_firmware(args.exe, args.peripheral_hci)
+
+    try:
+        # Let the boot time writes, e.g. the loaded defaults, settle first
+        await asyncio.sleep((args.save_delay_ms + args.margin_ms) / 1000.0)
+        return [await scenario(args, proc, toggles)
+                for toggles in (args.toggles, args.toggles + 1)]
+    finally:
+        proc.terminate()
+        await proc.wait()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", required=True, help="native_sim zephyr.exe")
+    parser.add_argument("--output", help="JSON result file, default stdout")
+    parser.add_argument("--peripheral-hci", default="hci0")
+    parser.add_argument("--toggles", type=int, default=2000,
+                        help="even, the odd run adds one")
+    parser.add_argument("--gap-ms", type=int, default=1)
+    parser.add_argument("--save-delay-ms", type=int, default=2000,
+                        help="CONFIG_APP_STATE_SAVE_DELAY_MS")
+    parser.add_argument("--max-delay-ms", type=int, default=30000,
+                        help="CONFIG_APP_STATE_SAVE_MAX_DELAY_MS")
+    parser.add_argument("--margin-ms", type=int, default=1000)
+    parser.add_argument("--timeout", type=float, default=30.0)
+    args = parser.parse_args()
+
+    report = new_report()
+    try:
+        report["results"] = asyncio.run(run(args))
+    except (RuntimeError, asyncio.TimeoutError, ValueError) as e:
+        report["error"] = str(e) or type(e).__name__
+
+    write_report(report, args.output)
+    if "error" in report:
+        return 1
+    return 0 if all(r["pass"] for r in report["results"]) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+"""Flash and RAM footprint per module, from the linker map of a build.
+
+The application is split per source file, so each module under src/modules
+gets its own row; everything else is grouped per library, e.g.
+subsys/bluetooth/host. Initialized data counts against both flash and RAM.
+
+    west build -t app_footprint
+
+or on any map file:
+
+    scripts/footprint.py build/zephyr/zephyr.map --top 30
+
+Regions are taken from the map's memory configuration. Maps without one,
+such as native_sim's, are classified by input section name instead.
+"""
+
+import argparse
+import collections
+import json
+import os
+import re
+import sys
+
+OUTPUT_RE = re.compile(r"^(\S+)?\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)"
+                       r"(?:\s+load address 0x([0-9a-f]+))?\s*$")
+INPUT_RE = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+REGION_RE = re.compile(r"^(\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)")
+OBJECT_RE = re.compile(r"^(?:(.*)\((.*)\)|(.*))$")
+
+FLASH_NAMES = ("flash", "rom")
+RAM_NAMES = ("ram", "sram", "iram", "dram")
+
+
+class Region:
+    def __init__(self, kind, origin, length):
+        self.kind = kind
+        self.origin = origin
+        self.end = origin + length
+
+    def holds(self, addr):
+        return self.origin <= addr < self.end
+
+
+def region_kind(name):
+    name = name.lower()
+    if any(n in name for n in FLASH_NAMES):
+        return "flash"
+    if any(n in name for n in RAM_NAMES):
+        return "ram"
+    return None
+
+
+def module_of(obj):
+    """Row name of an input object file or archive member."""
+    archive, member, plain = OBJECT_RE.match(obj).groups()
+    if plain is not None:
+        return os.path.basename(plain).replace(".c.obj", "").replace(".o", "")
+    base = os.path.basename(archive)
+    if base == "libapp.a":
+        return "app/" + member.replace(".c.obj", "")
+    if base.startswith("lib") and base.endswith(".a"):
+        return base[3:-2].replace("__", "/")
+    return base
+
+
+def by_section_name(name, size):
+    """(flash, ram) bytes of an input section, from its name alone."""
+    name = name.lstrip(".")
+    if name.startswith(("bss", "noinit", "tbss")) or name == "COMMON":
+        return 0, size
+    if name.startswith(("data", "tdata")):
+        return size, size
+    return size, 0
+
+
+class Map:
+    def __init__(self):
+        self.regions = []
+        self.flash = collections.Counter()
+        self.ram = collections.Counter()
+        self._vma_kind = None
+        self._lma_kind = None
+
+    def kind_at(self, addr):
+        for region in self.regions:
+            if region.holds(addr):
+                return region.kind
+        return None
+
+    def add(self, section, addr, size, obj):
+        if size == 0 or obj.startswith("*"):
+            return
+        module = module_of(obj)
+        if not self.regions:
+            flash, ram = by_section_name(section, size)
+            self.flash[module] += flash
+            self.ram[module] += ram
+            return
+
+        vma = self._vma_kind or self.kind_at(addr)
+        if vma == "ram":
+            self.ram[module] += size
+            if self._lma_kind == "flash":
+                self.flash[module] += size
+        elif vma == "flash":
+            self.flash[module] += size
+
+    def start_output(self, addr, lma):
+        self._vma_kind = self.kind_at(addr)
+        self._lma_kind = self.kind_at(lma) if lma is not None else None
+
+
+def parse(lines):
+    m = Map()
+    state = "head"
+    pending = None
+
+    for line in lines:
+        line = line.rstrip("\n")
+        if state == "head":
+            if line.startswith("Memory Configuration"):
+                state = "regions"
+            elif line.startswith("Linker script and memory map"):
+                state = "map"
+            continue
+
+        if state == "regions":
+            if line.startswith("Linker script and memory map"):
+                state = "map"
+                continue
+            match = REGION_RE.match(line)
+            if match and match.group(1) != "Name":
+                kind = region_kind(match.group(1))
+                if kind:
+                    m.regions.append(Region(kind, int(match.group(2), 16),
+                                            int(match.group(3), 16)))
+            continue
+
+        if line.startswith("OUTPUT(") or line.startswith("LOAD "):
+            continue
+
+        # Output section, name alone on its line when it is long
+        if line and not line[0].isspace():
+            match = OUTPUT_RE.match(line)
+            if match and match.group(1):
+                lma = match.group(4)
+                m.start_output(int(match.group(2), 16),
+                               int(lma, 16) if lma else None)
+                pending = None
+            elif " " not in line.strip():
+                pending = ("output", line.strip())
+            continue
+
+        # Input section, name alone when long, then address, size, object
+        if line.startswith(" ") and not line.startswith("  ") and \
+                line.strip() and not line.strip().startswith("0x"):
+            fields = line.split()
+            if len(fields) >= 4 and fields[1].startswith("0x"):
+                m.add(fields[0], int(fields[1], 16), int(fields[2], 16),
+                      " ".join(fields[3:]))
+                pending = None
+            elif len(fields) == 1:
+                pending = ("input", fields[0])
+            continue
+
+        if pending is None:
+            continue
+        if pending[0] == "output":
+            match = OUTPUT_RE.match(line)
+            if match:
+                lma = match.group(4)
+                m.start_output(int(match.group(2), 16),
+                               int(lma, 16) if lma else None)
+        else:
+            match = INPUT_RE.match(line)
+            if match:
+                m.add(pending[1], int(match.group(1), 16),
+                      int(match.group(2), 16), match.group(3))
+        pending = None
+
+    return m
+
+
+def report(m, top):
+    modules = set(m.flash) | set(m.ram)
+    rows = sorted(modules, key=lambda k: (-(m.flash[k] + m.ram[k]), k))
+    app = [r for r in rows if r.startswith("app/")]
+    rest = [r for r in rows if not r.startswith("app/")]
+    if top:
+        rest = rest[:top]
+
+    width = max([len(r) for r in app + rest] + [len("module")])
+    out = [f"{'module':<{width}} {'flash':>8} {'ram':>8}"]
+    for r in app + rest:
+        out.append(f"{r:<{width}} {m.flash[r]:>8} {m.ram[r]:>8}")
+    app_flash = sum(m.flash[r] for r in app)
+    app_ram = sum(m.ram[r] for r in app)
+    out.append(f"{'app total':<{width}} {app_flash:>8} {app_ram:>8}")
+    out.append(f"{'total':<{width}} {sum(m.flash.values()):>8} "
+               f"{sum(m.ram.values()):>8}")
+    return "\n".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map", help="zephyr.map of the build")
+    parser.add_argument("--top", type=int, default=20,
+                        help="libraries listed, 0 for all; app files always")
+    parser.add_argument("--json", help="also write the full table here")
+    args = parser.parse_args()
+
+    with open(args.map, errors="replace") as f:
+        m = parse(f)
+    if not m.flash and not m.ram:
+        print(f"{args.map}: no input sections found", file=sys.stderr)
+        return 1
+
+    print(report(m, args.top))
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({k: {"flash": m.flash[k], "ram": m.ram[k]}
+                       for k in sorted(set(m.flash) | set(m.ram))},
+                      f, indent=2)
+            f.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+"""Decoder for the bulk history transfer service (src/modules/history_svc.c).
+
+Each notification of the data characteristic is one chunk:
+
+    chunk number   uint16 LE
+    first seq      uint32 LE, sequence number of the first record
+    count          uint8, 0 ends the transfer
+    records        count delta encoded records
+    crc            uint16 LE, CRC-16/CCITT-FALSE over all of the above
+
+A record starts with the Blood Pressure Measurement flags byte. Bit 7 set
+means a varint with the number of skipped sequence numbers follows. Then
+come the systolic, diastolic and mean arterial pressure, and the fields the
+flags announce: time stamp in seconds since 1970, pulse rate, user ID and
+status. Each one is a zigzag varint of the difference to the previous
+record of the chunk, the first record is relative to zero.
+
+To resume after a lost link, write the control point again with the seq
+after the last record and the chunk number after the last chunk received:
+
+    01 <seq uint32 LE> <chunk uint16 LE>
+
+Run on a file with one hex encoded chunk per line to print the records.
+"""
+
+import argparse
+import datetime
+import struct
+import sys
+
+FLAG_UNIT_KPA = 0x01
+FLAG_TIME_STAMP = 0x02
+FLAG_PULSE_RATE = 0x04
+FLAG_USER_ID = 0x08
+FLAG_STATUS = 0x10
+FLAG_SEQ_GAP = 0x80
+
+CHUNK_HDR = struct.Struct("<HIB")
+
+
+class ChunkError(ValueError):
+    pass
+
+
+def crc16_ccitt_false(data, crc=0xFFFF):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def sfloat(raw):
+    """IEEE 11073 SFLOAT to a float, None for the special values."""
+    if raw in (0x07FF, 0x0800, 0x07FE, 0x0802, 0x0801):
+        return None
+    mantissa = raw & 0x0FFF
+    exponent = raw >> 12
+    if mantissa >= 0x0800:
+        mantissa -= 0x1000
+    if exponent >= 0x8:
+        exponent -= 0x10
+    return mantissa * 10.0 ** exponent
+
+
+class _Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def u8(self):
+        if self.pos >= len(self.data):
+            raise ChunkError("record truncated")
+        self.pos += 1
+        return self.data[self.pos - 1]
+
+    def varint(self):
+        value = shift = 0
+        while True:
+            byte = self.u8()
+            value |= (byte & 0x7F) << shift
+            if not byte & 0x80:
+                return value
+            shift += 7
+
+    def delta(self):
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+
+def decode_chunk(data):
+    """Return (chunk number, records) of one notification.
+
+    Records are dicts with the sequence number, flags and the raw field
+    values as sent in a Blood Pressure Measurement. Raises ChunkError on a
+    CRC mismatch or a malformed chunk.
+    """
+    if len(data) < CHUNK_HDR.size + 2:
+        raise ChunkError("chunk too short")
+    body, crc = data[:-2], struct.unpack_from("<H", data, len(data) - 2)[0]
+    if crc16_ccitt_false(body) != crc:
+        raise ChunkError("CRC mismatch")
+
+    chunk, first_seq, count = CHUNK_HDR.unpack_from(body)
+    reader = _Reader(body[CHUNK_HDR.size:])
+    prev = dict(seq=first_seq - 1, systolic=0, diastolic=0, mean_arterial=0,
+                time=0, pulse_rate=0, user_id=0, status=0)
+    records = []
+
+    for _ in range(count):
+        flags = reader.u8()
+        seq = prev["seq"] + 1
+        if flags & FLAG_SEQ_GAP:
+            seq += reader.varint()
+            flags &= ~FLAG_SEQ_GAP
+        rec = dict(seq=seq, flags=flags)
+
+        fields = ["systolic", "diastolic", "mean_arterial"]
+        if flags & FLAG_TIME_STAMP:
+            fields.append("time")
+        if flags & FLAG_PULSE_RATE:
+            fields.append("pulse_rate")
+        if flags & FLAG_USER_ID:
+            fields.append("user_id")
+        if flags & FLAG_STATUS:
+            fields.append("status")
+
+        for name in fields:
+            bits = 0xFF if name == "user_id" else \
+                0xFFFFFFFF if name == "time" else 0xFFFF
+            rec[name] = (prev[name] + reader.delta()) & bits
+        prev.update(rec)
+        records.append(rec)
+
+    if reader.pos != len(reader.data):
+        raise ChunkError("trailing bytes")
+    return chunk, records
+
+
+class Transfer:
+    """Collect chunks in order and know where to resume from."""
+
+    def __init__(self, from_seq=0, first_chunk=0):
+        self.next_seq = from_seq
+        self.next_chunk = first_chunk
+        self.records = []
+        self.done = False
+
+    def feed(self, data):
+        chunk, records = decode_chunk(data)
+        if chunk != self.next_chunk:
+            raise ChunkError(f"chunk {chunk}, expected {self.next_chunk}")
+        self.next_chunk = (chunk + 1) & 0xFFFF
+        if not records:
+            self.done = True
+        else:
+            self.records.extend(records)
+            self.next_seq = records[-1]["seq"] + 1
+        return records
+
+    def resume_request(self):
+        return struct.pack("<BIH", 0x01, self.next_seq, self.next_chunk)
+
+
+def format_record(rec):
+    unit = "kPa" if rec["flags"] & FLAG_UNIT_KPA else "mmHg"
+    text = (f"#{rec['seq']}: {sfloat(rec['systolic']):g}/"
+            f"{sfloat(rec['diastolic']):g} ({sfloat(rec['mean_arterial']):g})"
+            f" {unit}")
+    if "time" in rec:
+        text += " " + (datetime.datetime.fromtimestamp(
+            rec["time"], datetime.timezone.utc).strftime("%Y-%m-%d %H:%M:%S")
+            if rec["time"] else "time unknown")
+    if "pulse_rate" in rec:
+        text += f" pulse {sfloat(rec['pulse_rate']):g}"
+    if "user_id" in rec:
+        text += f" user {rec['user_id']}"
+    if "status" in rec:
+        text += f" status 0x{rec['status']:04x}"
+    return text
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("file", nargs="?", type=argparse.FileType("r"),
+                        default=sys.stdin, help="hex encoded chunks")
+    args = parser.parse_args()
+
+    transfer = None
+    for line in args.file:
+        line = line.strip()
+        if not line:
+            continue
+        data = bytes.fromhex(line)
+        if transfer is None:
+            transfer = Transfer(first_chunk=CHUNK_HDR.unpack_from(data)[0])
+        for rec in transfer.feed(data):
+            print(format_record(rec))
+
+    if transfer is None or not transfer.done:
+        print("Transfer incomplete, resume with",
+              (transfer or Transfer()).resume_request().hex())
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""Load sweep and soak on the native_sim build, to find where it saturates.
+
+Runs "load soak" once per pattern of the sweep, from light to heavy, and
+collects the report the firmware logs at the end of each: drops, sender
+queue depth, submit latency percentiles, CPU load and the stack and heap
+high-water marks. A pattern saturates the firmware when records are lost
+or the sender queue has not drained by the next burst. Needs a build with
+CONFIG_APP_LOAD_GEN, as native_sim has by default:
+
+    sudo btvirt -l2
+    west build -b native_sim -t soak
+
+Without --connect nobody is subscribed: records are only stored, which
+exercises the store and its buffering, and the firmware runs with -no-rt
+so hours pass in minutes. With --connect a central on the second
+controller subscribes to Blood Pressure Measurement first and the soak runs
+in real time, so keep --minutes short.
+"""
+
+import argparse
+import asyncio
+import contextlib
+import re
+import sys
+import time
+
+from bleak import BleakClient
+
+from bench_central import (new_report, start_firmware, wait_for_adv,
+                           write_report)
+
+BPM_UUID = "00002a35-0000-1000-8000-00805f9b34fb"
+
+# Report lines, see report() in src/modules/load_gen.c
+PATTERNS = {
+    "submitted": re.compile(r"submitted (\d+) \((\d+)/s\), failed (\d+), "
+                            r"queue full (\d+), dropped (\d+)"),
+    "sent": re.compile(r"sent (\d+), acked (\d+), stored (\d+) in (\d+) "
+                       r"batches"),
+    "queue": re.compile(r"queue max (\d+) of (\d+), avg (\d+) after a burst, "
+                        r"(\d+) late bursts of (\d+)"),
+    "submit_us": re.compile(r"submit us p50 (\d+) p90 (\d+) p99 (\d+) "
+                            r"p99\.9 (\d+) max (\d+)"),
+    "tx_us": re.compile(r"tx_complete us avg (\d+) p99 (\d+) max (\d+) "
+                        r"over (\d+) bursts"),
+    "cpu": re.compile(r"cpu max (\d+)\.(\d) %, heap max (\d+) of (\d+)"),
+    "stack": re.compile(r"stack (.+?) max (\d+) of (\d+)"),
+}
+
+
+class Firmware:
+    """zephyr.exe with its shell and log on stdin/stdout."""
+
+    def __init__(self, proc):
+        self.proc = proc
+
+    async def send(self, command):
+        self.proc.stdin.write((command + "\n").encode())
+        await self.proc.stdin.drain()
+
+    async def readline(self, timeout):
+        line = await asyncio.wait_for(self.proc.stdout.readline(), timeout)
+        if not line:
+            raise RuntimeError("firmware exited")
+        return line.decode(errors="replace")
+
+    async def wait_for(self, pattern, timeout):
+        while True:
+            match = re.search(pattern, await self.readline(timeout))
+            if match:
+                return match
+
+
+async def read_report(fw, settle_s):
+    """Parse the report lines, the optional ones follow submit_us."""
+    report = {"stacks": {}}
+    deadline = None
+
+    while deadline is None or time.monotonic() < deadline:
+        timeout = 600.0 if deadline is None else deadline - time.monotonic()
+        try:
+            line = await fw.readline(max(timeout, 0.01))
+        except asyncio.TimeoutError:
+            break
+        for key, pattern in PATTERNS.items():
+            match = pattern.search(line)
+            if not match:
+                continue
+            if key == "stack":
+                report["stacks"][match.group(1)] = {
+                    "max": int(match.group(2)), "size": int(match.group(3))}
+            else:
+                report[key] = [int(v) for v in match.groups()]
+            if key == "submit_us":
+                deadline = time.monotonic() + settle_s
+    return report
+
+
+def summarize(interval_ms, burst, raw):
+    submitted, rate, failed, queue_full, dropped = raw["submitted"]
+    depth_max, queue_len, depth_avg, late, bursts = raw["queue"]
+    p50, p90, p99, p999, worst = raw["submit_us"]
+    result = {
+        "interval_ms": interval_ms,
+        "burst": burst,
+        "offered_per_s": round(burst * 1000.0 / interval_ms, 1),
+        "submitted": submitted,
+        "submitted_per_s": rate,
+        "failed": failed,
+        "queue_full": queue_full,
+        "dropped": dropped,
+        "queue": {"max": depth_max, "len": queue_len, "avg": depth_avg,
+                  "late_bursts": late, "bursts": bursts},
+        "submit_us": {"p50": p50, "p90": p90, "p99": p99, "p99_9": p999,
+                      "max": worst},
+        "stacks": raw["stacks"],
+    }
+    if "sent" in raw:
+        sent, acked, stored, batches = raw["sent"]
+        result.update(sent=sent, acked=acked, stored=stored,
+                      batches_written=batches)
+    if "tx_us" in raw:
+        avg, p99, worst, count = raw["tx_us"]
+        result["tx_complete_us"] = {"avg": avg, "p99": p99, "max": worst,
+                                    "bursts": count}
+    if "cpu" in raw:
+        whole, tenth, heap_max, heap_size = raw["cpu"]
+        result["cpu_max_pct"] = whole + tenth / 10.0
+        result["heap"] = {"max": heap_max, "size": heap_size}
+
+    result["saturated"] = bool(failed or queue_full or dropped or
+                               late * 100 > bursts)
+    return result
+
+
+async def sweep(args, fw):
+    results = []
+    for pattern in args.patterns:
+        interval_ms, burst = (int(v) for v in pattern.split(":"))
+        await fw.send(f"load soak {args.minutes} {interval_ms} {burst}")
+        await fw.wait_for("Soak started", args.timeout)
+        await fw.wait_for("Soak done", args.minutes * 60 + args.timeout)
+        results.append(summarize(interval_ms, burst,
+                                 await read_report(fw, args.settle_s)))
+        if results[-1]["saturated"] and not args.keep_going:
+            break
+    return results
+
+
+async def run(args):
+    proc = await start_firmware(args.exe, args.peripheral_hci,
+                                *([] if args.connect else ["-no-rt"]))
+    fw = Firmware(proc)
+
+    try:
+        if not args.connect:
+            return await sweep(args, fw)
+
+        device = await wait_for_adv(args.central_hci, args.timeout)
+        async with BleakClient(device, adapter=args.central_hci) as client:
+            await client.pair()
+            await client.start_notify(BPM_UUID, lambda *_: None)
+            results = await sweep(args, fw)
+            with contextlib.suppress(Exception):
+                await client.stop_notify(BPM_UUID)
+            return results
+    finally:
+        proc.terminate()
+        await proc.wait()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", required=True, help="native_sim zephyr.exe")
+    parser.add_argument("--output", help="JSON result file, default stdout")
+    parser.add_argument("--peripheral-hci", default="hci0")
+    parser.add_argument("--central-hci", default="hci1")
+    parser.add_argument("--connect", action="store_true",
+                        help="soak with a subscribed central, in real time")
+    parser.add_argument("--patterns", nargs="+",
+                        default=["1000:1", "100:1", "20:1", "10:2", "10:5",
+                                 "10:10", "5:20"],
+                        help="interval_ms:burst, from light to heavy")
+    parser.add_argument("--minutes", type=int, default=60,
+                        help="length of each soak")
+    parser.add_argument("--keep-going", action="store_true",
+                        help="run the patterns past the first saturation")
+    parser.add_argument("--settle-s", type=float, default=1.0,
+                        help="wait for the optional report lines")
+    parser.add_argument("--timeout", type=float, default=60.0)
+    args = parser.parse_args()
+
+    report = new_report(connected=args.connect)
+    try:
+        results = asyncio.run(run(args))
+        report["results"] = results
+        saturated = [r for r in results if r["saturated"]]
+        if saturated:
+            report["saturates_at_per_s"] = saturated[0]["offered_per_s"]
+    except (RuntimeError, asyncio.TimeoutError, ValueError, KeyError) as e:
+        report["error"] = str(e) or type(e).__name__
+
+    write_report(report, args.output)
+    return 1 if "error" in report else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,309 @@
+/** @file
+ *  @brief Advertising and reconnect strategy
+ */
+
+#include "advertising.h"
+#include "app_state.h"
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/shell/shell.h>
+
+LOG_MODULE_REGISTER(advertising);
+
+static const struct bt_data ad[] = {
+    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+    BT_DATA_BYTES(BT_DATA_UUID16_ALL, BT_UUID_16_ENCODE(BT_UUID_BPS_VAL),
+                  BT_UUID_16_ENCODE(BT_UUID_BAS_VAL)),
+    // Time comes from the central's Current Time Service
+    BT_DATA_BYTES(BT_DATA_SOLICIT16, BT_UUID_16_ENCODE(BT_UUID_CTS_VAL)),
+};
+
+// One time: restarts after a disconnect go through the strategy again
+static const struct bt_le_adv_param undirected_param = BT_LE_ADV_PARAM_INIT(
+    BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_USE_NAME |
+        BT_LE_ADV_OPT_ONE_TIME,
+    BT_GAP_ADV_FAST_INT_MIN_2, BT_GAP_ADV_FAST_INT_MAX_2, NULL);
+
+static const char* const phase_str[ADV_PHASE_COUNT] = {
+    [ADV_PHASE_IDLE] = "idle",
+    [ADV_PHASE_DIRECTED_HIGH] = "directed high duty",
+    [ADV_PHASE_DIRECTED_LOW] = "directed low duty",
+    [ADV_PHASE_UNDIRECTED] = "undirected",
+};
+
+static K_MUTEX_DEFINE(adv_lock);
+static bool enabled;
+static enum adv_phase phase;
+static bt_addr_le_t peer_addr;
+static int64_t started_at;
+static int64_t first_adv_ms;
+static struct advertising_stats stats = {.min_ms = UINT32_MAX};
+
+static void phase_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(phase_work, phase_work_fn);
+
+struct bond_pick {
+  bt_addr_le_t preferred;
+  bool found;
+};
+
+// The central of the last connection if it is bonded, else the last bond
+static void pick_bond(const struct bt_bond_info* info, void* data) {
+  struct bond_pick* pick = data;
+
+  if (!pick->found) {
+    bt_addr_le_copy(&peer_addr, &info->addr);
+    pick->found = bt_addr_le_eq(&info->addr, &pick->preferred);
+  }
+}
+
+static int start_phase(enum adv_phase next) {
+  struct bt_le_adv_param param;
+  int err;
+
+  switch (next) {
+    case ADV_PHASE_DIRECTED_HIGH:
+      param = *BT_LE_ADV_CONN_DIR(&peer_addr);
+      break;
+    case ADV_PHASE_DIRECTED_LOW:
+      param = *BT_LE_ADV_CONN_DIR_LOW_DUTY(&peer_addr);
+      break;
+    default:
+      param = undirected_param;
+      next = ADV_PHASE_UNDIRECTED;
+      break;
+  }
+
+  if (next != ADV_PHASE_UNDIRECTED) {
+    if (IS_ENABLED(CONFIG_BT_PRIVACY)) {
+      param.options |= BT_LE_ADV_OPT_DIR_ADDR_RPA;
+    }
+    err = bt_le_adv_start(&param, NULL, 0, NULL, 0);
+  } else {
+    err = bt_le_adv_start(&param, ad, ARRAY_SIZE(ad), NULL, 0);
+  }
+
+  if (err) {
+    LOG_WRN("Cannot start %s advertising (err %d)", phase_str[next], err);
+    // Directed advertising unsupported or rejected: fall back right away
+    if (next != ADV_PHASE_UNDIRECTED) {
+      return start_phase(ADV_PHASE_UNDIRECTED);
+    }
+    phase = ADV_PHASE_IDLE;
+    return err;
+  }
+
+  phase = next;
+  LOG_DBG("Advertising %s", phase_str[next]);
+
+  if (!first_adv_ms) {
+    first_adv_ms = MAX(k_uptime_get(), 1);
+    if (first_adv_ms > CONFIG_APP_BOOT_ADV_BUDGET_MS) {
+      LOG_WRN("First advertisement %lld ms after boot, budget %d ms",
+              first_adv_ms, CONFIG_APP_BOOT_ADV_BUDGET_MS);
+    } else {
+      LOG_INF("First advertisement %lld ms after boot", first_adv_ms);
+    }
+  }
+
+  if (next == ADV_PHASE_DIRECTED_LOW) {
+    k_work_reschedule(&phase_work,
+                      K_MSEC(CONFIG_APP_RECONNECT_LOW_DUTY_TIMEOUT_MS));
+  }
+  return 0;
+}
+
+int advertising_start(void) {
+  enum adv_phase first = ADV_PHASE_UNDIRECTED;
+  int err;
+
+  k_mutex_lock(&adv_lock, K_FOREVER);
+
+  enabled = true;
+  started_at = k_uptime_get();
+  k_work_cancel_delayable(&phase_work);
+
+  if (IS_ENABLED(CONFIG_APP_FAST_RECONNECT)) {
+    struct app_state state;
+    struct bond_pick pick = {.found = false};
+
+    app_state_get(&state);
+    bt_addr_le_copy(&pick.preferred, &state.last_peer);
+    bt_addr_le_copy(&peer_addr, BT_ADDR_LE_NONE);
+    bt_foreach_bond(BT_ID_DEFAULT, pick_bond, &pick);
+    if (bt_addr_le_cmp(&peer_addr, BT_ADDR_LE_NONE) != 0) {
+      struct bt_conn* conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, &peer_addr);
+
+      // Already connected: advertise for the other centrals instead
+      if (conn) {
+        bt_conn_unref(conn);
+      } else {
+        first = ADV_PHASE_DIRECTED_HIGH;
+      }
+    }
+  }
+
+  err = start_phase(first);
+
+  k_mutex_unlock(&adv_lock);
+  return err;
+}
+
+int advertising_stop(void) {
+  int err = 0;
+
+  k_mutex_lock(&adv_lock, K_FOREVER);
+
+  enabled = false;
+  k_work_cancel_delayable(&phase_work);
+  if (phase != ADV_PHASE_IDLE) {
+    err = bt_le_adv_stop();
+    phase = ADV_PHASE_IDLE;
+  }
+
+  k_mutex_unlock(&adv_lock);
+  return err;
+}
+
+static void phase_work_fn(struct k_work* work) {
+  ARG_UNUSED(work);
+
+  k_mutex_lock(&adv_lock, K_FOREVER);
+
+  if (!enabled) {
+    goto out;
+  }
+
+  switch (phase) {
+    case ADV_PHASE_DIRECTED_HIGH:
+      // Timed out in the controller
+      start_phase(ADV_PHASE_DIRECTED_LOW);
+      break;
+    case ADV_PHASE_DIRECTED_LOW:
+      bt_le_adv_stop();
+      start_phase(ADV_PHASE_UNDIRECTED);
+      break;
+    case ADV_PHASE_IDLE:
+      // Restart after a disconnect
+      k_mutex_unlock(&adv_lock);
+      advertising_start();
+      return;
+    default:
+      break;
+  }
+
+out:
+  k_mutex_unlock(&adv_lock);
+}
+
+void advertising_get_stats(struct advertising_stats* out) {
+  k_mutex_lock(&adv_lock, K_FOREVER);
+  *out = stats;
+  k_mutex_unlock(&adv_lock);
+}
+
+void advertising_reset_stats(void) {
+  k_mutex_lock(&adv_lock, K_FOREVER);
+  stats = (struct advertising_stats){.min_ms = UINT32_MAX};
+  k_mutex_unlock(&adv_lock);
+}
+
+enum adv_phase advertising_phase(void) {
+  // A single word, read without the lock so samplers never wait on a phase
+  // change in progress
+  return phase;
+}
+
+static void connected(struct bt_conn* conn, uint8_t err) {
+  ARG_UNUSED(conn);
+
+  if (err == BT_HCI_ERR_ADV_TIMEOUT) {
+    k_work_reschedule(&phase_work, K_NO_WAIT);
+    return;
+  }
+  if (err) {
+    return;
+  }
+
+  k_mutex_lock(&adv_lock, K_FOREVER);
+
+  uint32_t elapsed = (uint32_t)(k_uptime_get() - started_at);
+
+  if (phase != ADV_PHASE_IDLE) {
+    stats.connections[phase]++;
+    stats.last_ms = elapsed;
+    stats.min_ms = MIN(stats.min_ms, elapsed);
+    stats.max_ms = MAX(stats.max_ms, elapsed);
+    stats.total_ms += elapsed;
+    LOG_INF("Connected after %u ms of %s advertising", elapsed,
+            phase_str[phase]);
+  }
+
+  // Connectable advertising ends with the connection. Keep advertising for
+  // further centrals, start_phase() fails harmlessly once all
+  // CONFIG_BT_MAX_CONN links are in use and the next disconnect retries.
+  phase = ADV_PHASE_IDLE;
+  if (enabled) {
+    k_work_reschedule(&phase_work, K_NO_WAIT);
+  } else {
+    k_work_cancel_delayable(&phase_work);
+  }
+
+  k_mutex_unlock(&adv_lock);
+}
+
+static void disconnected(struct bt_conn* conn, uint8_t reason) {
+  ARG_UNUSED(conn);
+  ARG_UNUSED(reason);
+
+  if (enabled) {
+    k_work_reschedule(&phase_work, K_NO_WAIT);
+  }
+}
+
+BT_CONN_CB_DEFINE(adv_conn_callbacks) = {
+    .connected = connected,
+    .disconnected = disconnected,
+};
+
+#if IS_ENABLED(CONFIG_APP_ADVERTISING_SHELL)
+static int cmd_adv_show(const struct shell* sh, size_t argc, char** argv) {
+  struct advertising_stats s;
+  uint32_t count = 0;
+
+  advertising_get_stats(&s);
+  for (size_t i = ADV_PHASE_IDLE + 1; i < ADV_PHASE_COUNT; i++) {
+    shell_print(sh, "%-18s %u connections", phase_str[i], s.connections[i]);
+    count += s.connections[i];
+  }
+  if (count == 0) {
+    shell_print(sh, "No connection yet");
+    return 0;
+  }
+  shell_print(sh, "time to connect: last %u ms, min %u, max %u, avg %llu",
+              s.last_ms, s.min_ms, s.max_ms, s.total_ms / count);
+  return 0;
+}
+
+static int cmd_adv_reset(const struct shell* sh, size_t argc, char** argv) {
+  advertising_reset_stats();
+  shell_print(sh, "Advertising statistics reset");
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    adv_cmds,
+    SHELL_CMD(show, NULL, "Connections per phase and time to connect",
+              cmd_adv_show),
+    SHELL_CMD(reset, NULL, "Start counting from now", cmd_adv_reset),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(adv, &adv_cmds, "Advertising and reconnect strategy", NULL);
+#endif
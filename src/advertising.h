@@ -0,0 +1,52 @@
+/** @file
+ *  @brief Advertising and reconnect strategy
+ */
+
+#ifndef ST_BLE_ADVERTISING_H_
+#define ST_BLE_ADVERTISING_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum adv_phase {
+  ADV_PHASE_IDLE,
+  // High duty directed advertising to the bonded central, 1.28 s
+  ADV_PHASE_DIRECTED_HIGH,
+  // Low duty directed advertising to the bonded central
+  ADV_PHASE_DIRECTED_LOW,
+  ADV_PHASE_UNDIRECTED,
+
+  ADV_PHASE_COUNT
+};
+
+struct advertising_stats {
+  // Connections made, per phase that was running when the central connected
+  uint32_t connections[ADV_PHASE_COUNT];
+  // Time from advertising start to connection
+  uint32_t last_ms;
+  uint32_t min_ms;
+  uint32_t max_ms;
+  uint64_t total_ms;
+};
+
+// Start advertising, directed to the bonded central first if there is one.
+// Advertising restarts by itself after a disconnect until stopped.
+int advertising_start(void);
+
+int advertising_stop(void);
+
+// Counted since boot or the last advertising_reset_stats()
+void advertising_get_stats(struct advertising_stats* stats);
+void advertising_reset_stats(void);
+
+// Phase running now, ADV_PHASE_IDLE while stopped or connected
+enum adv_phase advertising_phase(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_ADVERTISING_H_ */
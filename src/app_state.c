@@ -0,0 +1,250 @@
+/** @file
+ *  @brief Application state kept across reboots
+ */
+
+#include "app_state.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/shell/shell.h>
+
+#include <zephyr/bluetooth/bluetooth.h>
+
+#include "modules/button_state.h"
+
+LOG_MODULE_REGISTER(app_state);
+
+#define SAVE_DELAY K_MSEC(CONFIG_APP_STATE_SAVE_DELAY_MS)
+// A failed write is tried again after this long, the change stays dirty
+#define SAVE_RETRY K_MSEC(MAX(CONFIG_APP_STATE_SAVE_DELAY_MS, 1000))
+
+// Stored layout, fields may only be appended
+struct stored_state {
+  uint8_t adv_enabled;
+  bt_addr_le_t last_peer;
+} __packed;
+
+static K_MUTEX_DEFINE(state_lock);
+static struct stored_state state = {
+    .adv_enabled = 1,
+};
+// What flash holds, to skip writes of changes that were undone
+static struct stored_state saved = {
+    .adv_enabled = 1,
+};
+// First change not yet written, 0 if none
+static int64_t dirty_since;
+
+static struct {
+  uint32_t updates;
+  uint32_t writes;
+  uint32_t unchanged;
+  uint32_t write_max_us;
+  uint64_t write_total_us;
+} stats;
+
+static void save_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(save_work, save_work_fn);
+
+static int state_set(const char* key, size_t len, settings_read_cb read_cb,
+                     void* cb_arg) {
+  ssize_t rc;
+
+  if (key) {
+    return -ENOENT;
+  }
+
+  k_mutex_lock(&state_lock, K_FOREVER);
+  rc = read_cb(cb_arg, &state, MIN(len, sizeof(state)));
+  saved = state;
+  k_mutex_unlock(&state_lock);
+
+  return (rc < 0) ? rc : 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(app_state, APP_STATE_SUBTREE, NULL, state_set,
+                               NULL, NULL);
+
+// Caller holds state_lock. The write waits for a quiet period, but no longer
+// than CONFIG_APP_STATE_SAVE_MAX_DELAY_MS after the first change, so a
+// steady stream of changes still reaches flash.
+static void changed(void) {
+  int64_t now = k_uptime_get();
+  int64_t left;
+
+  stats.updates++;
+  if (dirty_since == 0) {
+    dirty_since = now;
+  }
+  left = dirty_since + CONFIG_APP_STATE_SAVE_MAX_DELAY_MS - now;
+  k_work_reschedule(&save_work,
+                    K_MSEC(CLAMP(left, 0, CONFIG_APP_STATE_SAVE_DELAY_MS)));
+}
+
+static int save(void) {
+  struct stored_state copy;
+  uint32_t start, us;
+  int err;
+
+  k_mutex_lock(&state_lock, K_FOREVER);
+  if (!memcmp(&state, &saved, sizeof(state))) {
+    dirty_since = 0;
+    stats.unchanged++;
+    k_mutex_unlock(&state_lock);
+    return 0;
+  }
+  copy = state;
+  k_mutex_unlock(&state_lock);
+
+  start = k_cycle_get_32();
+  err = settings_save_one(APP_STATE_SUBTREE, &copy, sizeof(copy));
+  us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+  if (err) {
+    LOG_WRN("Cannot save app state (err %d)", err);
+    k_work_reschedule(&save_work, SAVE_RETRY);
+    return err;
+  }
+
+  k_mutex_lock(&state_lock, K_FOREVER);
+  saved = copy;
+  // A change made during the write stays dirty, its save is scheduled
+  if (!memcmp(&state, &saved, sizeof(state))) {
+    dirty_since = 0;
+  }
+  stats.writes++;
+  stats.write_total_us += us;
+  stats.write_max_us = MAX(stats.write_max_us, us);
+  k_mutex_unlock(&state_lock);
+  return 0;
+}
+
+static void save_work_fn(struct k_work* work) {
+  ARG_UNUSED(work);
+
+  save();
+}
+
+void app_state_get(struct app_state* out) {
+  k_mutex_lock(&state_lock, K_FOREVER);
+  out->adv_enabled = state.adv_enabled;
+  bt_addr_le_copy(&out->last_peer, &state.last_peer);
+  k_mutex_unlock(&state_lock);
+}
+
+void app_state_set_adv_enabled(bool enabled) {
+  k_mutex_lock(&state_lock, K_FOREVER);
+  if (state.adv_enabled != enabled) {
+    state.adv_enabled = enabled;
+    changed();
+  }
+  k_mutex_unlock(&state_lock);
+}
+
+void app_state_set_last_peer(const bt_addr_le_t* addr) {
+  k_mutex_lock(&state_lock, K_FOREVER);
+  if (!bt_addr_le_eq(&state.last_peer, addr)) {
+    bt_addr_le_copy(&state.last_peer, addr);
+    changed();
+  }
+  k_mutex_unlock(&state_lock);
+}
+
+int app_state_flush(void) {
+  struct k_work_sync sync;
+
+  // Nothing scheduled, nothing to write
+  if (!k_work_cancel_delayable_sync(&save_work, &sync)) {
+    return 0;
+  }
+  return save();
+}
+
+void app_state_get_stats(struct app_state_stats* out) {
+  k_mutex_lock(&state_lock, K_FOREVER);
+  out->updates = stats.updates;
+  out->writes = stats.writes;
+  out->unchanged = stats.unchanged;
+  out->write_max_us = stats.write_max_us;
+  out->write_avg_us = stats.writes ? stats.write_total_us / stats.writes : 0;
+  k_mutex_unlock(&state_lock);
+}
+
+#if IS_ENABLED(CONFIG_APP_STATE_SHELL)
+static int cmd_app_state_show(const struct shell* sh, size_t argc,
+                              char** argv) {
+  struct app_state_stats s;
+  struct app_state st;
+  char addr[BT_ADDR_LE_STR_LEN];
+
+  app_state_get(&st);
+  app_state_get_stats(&s);
+  bt_addr_le_to_str(&st.last_peer, addr, sizeof(addr));
+
+  shell_print(sh, "adv %s, last peer %s, %s", st.adv_enabled ? "on" : "off",
+              addr,
+              k_work_delayable_is_pending(&save_work) ? "dirty" : "clean");
+  shell_print(sh, "%u updates, %u writes, %u avoided, %u unchanged",
+              s.updates, s.writes, s.updates - MIN(s.writes, s.updates),
+              s.unchanged);
+  shell_print(sh, "write us avg %u max %u", s.write_avg_us, s.write_max_us);
+  return 0;
+}
+
+static int cmd_app_state_flush(const struct shell* sh, size_t argc,
+                               char** argv) {
+  int err = app_state_flush();
+
+  if (err) {
+    shell_error(sh, "Flush failed (err %d)", err);
+    return err;
+  }
+  shell_print(sh, "Flushed");
+  return 0;
+}
+
+// Toggle advertising like a short click does, through the status bits and
+// the dispatcher, which hands each change to the cache
+static int cmd_app_state_stress(const struct shell* sh, size_t argc,
+                                char** argv) {
+  long toggles = strtol(argv[1], NULL, 0);
+  long gap_ms = argc > 2 ? strtol(argv[2], NULL, 0) : 1;
+  struct app_state_stats before, after;
+
+  if (toggles <= 0 || gap_ms < 0) {
+    shell_error(sh, "Usage: app_state stress <toggles> [gap_ms]");
+    return -EINVAL;
+  }
+
+  app_state_get_stats(&before);
+  for (long i = 0; i < toggles; i++) {
+    if (atomic_test_bit(&get_status()->status_bits, ADV_ENABLE)) {
+      atomic_clear_bit(&get_status()->status_bits, ADV_ENABLE);
+    } else {
+      atomic_set_bit(&get_status()->status_bits, ADV_ENABLE);
+    }
+    post_status_event(STATUS_EVT_ADV);
+    k_msleep(gap_ms);
+  }
+  app_state_get_stats(&after);
+
+  shell_print(sh, "Toggled %ld times: %u updates, %u writes so far", toggles,
+              after.updates - before.updates, after.writes - before.writes);
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    app_state_cmds,
+    SHELL_CMD(show, NULL, "State, cache and write counters",
+              cmd_app_state_show),
+    SHELL_CMD(flush, NULL, "Write a pending change now", cmd_app_state_flush),
+    SHELL_CMD_ARG(stress, NULL, "<toggles> [gap_ms] toggle advertising",
+                  cmd_app_state_stress, 2, 1),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(app_state, &app_state_cmds, "Persisted application state",
+                   NULL);
+#endif
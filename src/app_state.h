@@ -0,0 +1,58 @@
+/** @file
+ *  @brief Application state kept across reboots
+ */
+
+#ifndef ST_BLE_APP_STATE_H_
+#define ST_BLE_APP_STATE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/bluetooth/addr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Settings subtree, loaded before the first advertisement
+#define APP_STATE_SUBTREE "app/state"
+
+struct app_state {
+  // Advertising switched on with the button
+  bool adv_enabled;
+  // Central of the most recent connection, BT_ADDR_LE_ANY if none
+  bt_addr_le_t last_peer;
+};
+
+struct app_state_stats {
+  // Setter calls that changed the state in RAM
+  uint32_t updates;
+  // Settings writes, each one a flash write
+  uint32_t writes;
+  // Quiet periods that ended with the state back to what flash holds
+  uint32_t unchanged;
+  uint32_t write_max_us;
+  uint32_t write_avg_us;
+};
+
+// Current state, defaults until settings_load_subtree(APP_STATE_SUBTREE)
+void app_state_get(struct app_state* state);
+
+// Update in RAM only, callable from the Bluetooth callbacks. Changes are
+// written once the state has been left alone for
+// CONFIG_APP_STATE_SAVE_DELAY_MS, so a burst of changes costs one write and
+// one that is undone within the period none.
+void app_state_set_adv_enabled(bool enabled);
+void app_state_set_last_peer(const bt_addr_le_t* addr);
+
+// Write a pending change now, before a reset or reboot. Blocks for the flash
+// write.
+int app_state_flush(void);
+
+void app_state_get_stats(struct app_state_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_APP_STATE_H_ */
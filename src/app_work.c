@@ -0,0 +1,86 @@
+/** @file
+ *  @brief Application work queue for events from Bluetooth callbacks
+ */
+
+#include "app_work.h"
+#include "log_ratelimit.h"
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(app_work);
+
+struct app_work_item {
+  struct k_work work;
+  app_work_handler handler;
+  struct app_work_event evt;
+  uint32_t queued_at;
+};
+
+K_MEM_SLAB_DEFINE_STATIC(item_pool, sizeof(struct app_work_item),
+                         CONFIG_APP_WORK_POOL_SIZE, 4);
+
+static K_THREAD_STACK_DEFINE(work_q_stack, CONFIG_APP_WORK_STACK_SIZE);
+static struct k_work_q work_q;
+
+static atomic_t dropped;
+
+static void item_work_fn(struct k_work* work) {
+  struct app_work_item* item = CONTAINER_OF(work, struct app_work_item, work);
+
+  LOG_DBG("Event %d queued for %u us", item->evt.type,
+          k_cyc_to_us_floor32(k_cycle_get_32() - item->queued_at));
+
+  item->handler(&item->evt);
+
+  if (item->evt.conn) {
+    bt_conn_unref(item->evt.conn);
+  }
+  k_mem_slab_free(&item_pool, (void*)item);
+}
+
+void app_work_init(void) {
+  k_work_queue_start(&work_q, work_q_stack,
+                     K_THREAD_STACK_SIZEOF(work_q_stack),
+                     CONFIG_APP_WORK_PRIORITY, NULL);
+  k_thread_name_set(&work_q.thread, "app_work");
+}
+
+int app_work_submit(app_work_handler handler,
+                    const struct app_work_event* evt) {
+  struct app_work_item* item;
+
+  if (k_mem_slab_alloc(&item_pool, (void**)&item, K_NO_WAIT)) {
+    // Counted even while the log line is suppressed
+    atomic_val_t total = atomic_inc(&dropped) + 1;
+
+    LOG_RATELIMIT(LOG_WRN, "Work pool empty, event %d dropped (%ld so far)",
+                  evt->type, total);
+    return -ENOMEM;
+  }
+
+  k_work_init(&item->work, item_work_fn);
+  item->handler = handler;
+  item->evt = *evt;
+  item->queued_at = k_cycle_get_32();
+  if (item->evt.conn) {
+    item->evt.conn = bt_conn_ref(item->evt.conn);
+  }
+
+  k_work_submit_to_queue(&work_q, &item->work);
+  return 0;
+}
+
+#if IS_ENABLED(CONFIG_APP_WORK_CB_TIMING)
+void app_work_cb_timing(const char* name, uint32_t start) {
+  uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+  struct k_thread* thread = k_current_get();
+  size_t unused = 0;
+
+  k_thread_stack_space_get(thread, &unused);
+  LOG_INF("%s callback %u us, %s stack %zu/%zu used", name, us,
+          k_thread_name_get(thread) ?: "?",
+          thread->stack_info.size - unused, thread->stack_info.size);
+}
+#endif
@@ -0,0 +1,66 @@
+/** @file
+ *  @brief Application work queue for events from Bluetooth callbacks
+ */
+
+#ifndef ST_BLE_APP_WORK_H_
+#define ST_BLE_APP_WORK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum app_work_type {
+  APP_WORK_CONNECTED,
+  APP_WORK_DISCONNECTED,
+  APP_WORK_PAIRING_COMPLETE,
+  APP_WORK_BPM_CCC,
+  APP_WORK_LOAD_SETTINGS,
+  APP_WORK_CTS_DISCOVER,
+  APP_WORK_TIME_SYNCED,
+};
+
+struct app_work_event {
+  enum app_work_type type;
+  // Referenced while the event is queued, may be NULL
+  struct bt_conn* conn;
+  union {
+    // APP_WORK_CONNECTED
+    uint8_t err;
+    // APP_WORK_DISCONNECTED
+    uint8_t reason;
+    // APP_WORK_PAIRING_COMPLETE
+    bool bonded;
+    // APP_WORK_BPM_CCC
+    uint16_t ccc_value;
+  };
+};
+
+typedef void (*app_work_handler)(const struct app_work_event* evt);
+
+// Start the work queue thread, before bt_enable()
+void app_work_init(void);
+
+// Copy the event into a pool item and run handler on the work queue.
+// Callable from any context, never blocks. Returns -ENOMEM if the pool is
+// exhausted.
+int app_work_submit(app_work_handler handler, const struct app_work_event* evt);
+
+#if IS_ENABLED(CONFIG_APP_WORK_CB_TIMING)
+// Log the time since start and the stack high-water mark of the current
+// thread, call at the end of a Bluetooth callback
+void app_work_cb_timing(const char* name, uint32_t start);
+#else
+static inline void app_work_cb_timing(const char* name, uint32_t start) {}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_APP_WORK_H_ */
@@ -0,0 +1,144 @@
+/** @file
+ *  @brief Blood Pressure Measurement encoding
+ */
+
+#include "bpm.h"
+#include "log_ratelimit.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/timeutil.h>
+
+LOG_MODULE_REGISTER(bpm);
+
+int bpm_encode(const struct bpm_measurement* m, struct net_buf_simple* buf) {
+  uint32_t start = 0;
+
+  if (net_buf_simple_tailroom(buf) < BPM_ENCODED_LEN) {
+    return -ENOMEM;
+  }
+
+  if (IS_ENABLED(CONFIG_APP_BPM_ENCODE_CYCLES)) {
+    start = k_cycle_get_32();
+  }
+
+  // Every branch below folds to a constant, the layout is fixed at build time
+  net_buf_simple_add_u8(buf, BPM_FLAGS);
+  net_buf_simple_add_le16(buf, m->systolic);
+  net_buf_simple_add_le16(buf, m->diastolic);
+  net_buf_simple_add_le16(buf, m->mean_arterial);
+
+  if (IS_ENABLED(CONFIG_APP_BPM_TIME_STAMP)) {
+    net_buf_simple_add_le16(buf, m->time_stamp.year);
+    net_buf_simple_add_u8(buf, m->time_stamp.month);
+    net_buf_simple_add_u8(buf, m->time_stamp.day);
+    net_buf_simple_add_u8(buf, m->time_stamp.hours);
+    net_buf_simple_add_u8(buf, m->time_stamp.minutes);
+    net_buf_simple_add_u8(buf, m->time_stamp.seconds);
+  }
+
+  if (IS_ENABLED(CONFIG_APP_BPM_PULSE_RATE)) {
+    net_buf_simple_add_le16(buf, m->pulse_rate);
+  }
+
+  if (IS_ENABLED(CONFIG_APP_BPM_USER_ID)) {
+    net_buf_simple_add_u8(buf, m->user_id);
+  }
+
+  if (IS_ENABLED(CONFIG_APP_BPM_STATUS)) {
+    net_buf_simple_add_le16(buf, m->status);
+  }
+
+  if (IS_ENABLED(CONFIG_APP_BPM_ENCODE_CYCLES)) {
+    LOG_RATELIMIT(LOG_DBG, "Encoded %u bytes in %u cycles", BPM_ENCODED_LEN,
+                  k_cycle_get_32() - start);
+  }
+
+  return BPM_ENCODED_LEN;
+}
+
+int bpm_decode(const uint8_t* data, size_t len, struct bpm_measurement* m) {
+  struct net_buf_simple buf;
+  uint8_t flags;
+  size_t expected;
+
+  if (len < 1) {
+    return -EINVAL;
+  }
+
+  flags = data[0];
+  expected = 1 + 3 * 2 + ((flags & BPM_FLAG_TIME_STAMP) ? 7 : 0) +
+             ((flags & BPM_FLAG_PULSE_RATE) ? 2 : 0) +
+             ((flags & BPM_FLAG_USER_ID) ? 1 : 0) +
+             ((flags & BPM_FLAG_STATUS) ? 2 : 0);
+  if (len != expected) {
+    return -EINVAL;
+  }
+
+  memset(m, 0, sizeof(*m));
+  net_buf_simple_init_with_data(&buf, (void*)data, len);
+  net_buf_simple_pull_u8(&buf);
+  m->systolic = net_buf_simple_pull_le16(&buf);
+  m->diastolic = net_buf_simple_pull_le16(&buf);
+  m->mean_arterial = net_buf_simple_pull_le16(&buf);
+
+  if (flags & BPM_FLAG_TIME_STAMP) {
+    m->time_stamp.year = net_buf_simple_pull_le16(&buf);
+    m->time_stamp.month = net_buf_simple_pull_u8(&buf);
+    m->time_stamp.day = net_buf_simple_pull_u8(&buf);
+    m->time_stamp.hours = net_buf_simple_pull_u8(&buf);
+    m->time_stamp.minutes = net_buf_simple_pull_u8(&buf);
+    m->time_stamp.seconds = net_buf_simple_pull_u8(&buf);
+  }
+
+  if (flags & BPM_FLAG_PULSE_RATE) {
+    m->pulse_rate = net_buf_simple_pull_le16(&buf);
+  }
+
+  if (flags & BPM_FLAG_USER_ID) {
+    m->user_id = net_buf_simple_pull_u8(&buf);
+  }
+
+  if (flags & BPM_FLAG_STATUS) {
+    m->status = net_buf_simple_pull_le16(&buf);
+  }
+
+  return flags;
+}
+
+uint32_t bpm_time_to_secs(const struct bpm_time* t) {
+  struct tm tm = {
+      .tm_year = t->year - 1900,
+      .tm_mon = t->month - 1,
+      .tm_mday = t->day,
+      .tm_hour = t->hours,
+      .tm_min = t->minutes,
+      .tm_sec = t->seconds,
+  };
+
+  if (t->year == 0 || t->month == 0 || t->day == 0) {
+    return 0;
+  }
+  return (uint32_t)timeutil_timegm64(&tm);
+}
+
+int bpm_set_time_stamp(uint8_t* data, size_t len, const struct bpm_time* t) {
+  uint8_t* p = &data[BPM_TIME_STAMP_OFFSET];
+
+  if (len < BPM_TIME_STAMP_OFFSET + BPM_TIME_STAMP_LEN ||
+      !(data[0] & BPM_FLAG_TIME_STAMP)) {
+    return -EINVAL;
+  }
+
+  sys_put_le16(t->year, p);
+  p[2] = t->month;
+  p[3] = t->day;
+  p[4] = t->hours;
+  p[5] = t->minutes;
+  p[6] = t->seconds;
+  return 0;
+}
@@ -0,0 +1,114 @@
+/** @file
+ *  @brief Blood Pressure Measurement encoding
+ */
+
+#ifndef ST_BLE_BPM_H_
+#define ST_BLE_BPM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/net/buf.h>
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Blood Pressure Measurement flags (BLS 3.1.1.1)
+#define BPM_FLAG_UNIT_KPA BIT(0)
+#define BPM_FLAG_TIME_STAMP BIT(1)
+#define BPM_FLAG_PULSE_RATE BIT(2)
+#define BPM_FLAG_USER_ID BIT(3)
+#define BPM_FLAG_STATUS BIT(4)
+
+// Fields present in every encoded measurement, fixed by Kconfig
+#define BPM_FLAGS                                                     \
+  ((IS_ENABLED(CONFIG_APP_BPM_UNIT_KPA) ? BPM_FLAG_UNIT_KPA : 0) |    \
+   (IS_ENABLED(CONFIG_APP_BPM_TIME_STAMP) ? BPM_FLAG_TIME_STAMP : 0) | \
+   (IS_ENABLED(CONFIG_APP_BPM_PULSE_RATE) ? BPM_FLAG_PULSE_RATE : 0) | \
+   (IS_ENABLED(CONFIG_APP_BPM_USER_ID) ? BPM_FLAG_USER_ID : 0) |      \
+   (IS_ENABLED(CONFIG_APP_BPM_STATUS) ? BPM_FLAG_STATUS : 0))
+
+// Flags, systolic, diastolic and mean arterial pressure, then the optional
+// fields in order
+#define BPM_ENCODED_LEN                                  \
+  (1 + 3 * 2 + (IS_ENABLED(CONFIG_APP_BPM_TIME_STAMP) ? 7 : 0) + \
+   (IS_ENABLED(CONFIG_APP_BPM_PULSE_RATE) ? 2 : 0) +     \
+   (IS_ENABLED(CONFIG_APP_BPM_USER_ID) ? 1 : 0) +        \
+   (IS_ENABLED(CONFIG_APP_BPM_STATUS) ? 2 : 0))
+
+// Time Stamp position in an encoded measurement, right after the pressures
+#define BPM_TIME_STAMP_OFFSET (1 + 3 * 2)
+#define BPM_TIME_STAMP_LEN 7
+
+// IEEE 11073 16-bit SFLOAT: 4 bit exponent, 12 bit mantissa, both signed
+typedef uint16_t sfloat_t;
+
+#define SFLOAT(mantissa, exponent) \
+  ((sfloat_t)((((exponent) & 0xf) << 12) | ((mantissa) & 0xfff)))
+
+#define SFLOAT_NAN 0x07ff
+#define SFLOAT_NRES 0x0800
+#define SFLOAT_POS_INF 0x07fe
+#define SFLOAT_NEG_INF 0x0802
+
+// Unknown user (BLS 3.1.1.5)
+#define BPM_USER_UNKNOWN 0xff
+
+// Measurement Status bits (BLS 3.1.1.6)
+enum bpm_status {
+  BPM_STATUS_BODY_MOVEMENT = BIT(0),
+  BPM_STATUS_CUFF_LOOSE = BIT(1),
+  BPM_STATUS_IRREGULAR_PULSE = BIT(2),
+  BPM_STATUS_PULSE_RATE_HIGH = BIT(3),
+  BPM_STATUS_PULSE_RATE_LOW = (2 << 3),
+  BPM_STATUS_POSITION_IMPROPER = BIT(5),
+};
+
+// Date Time characteristic value, zero means unknown
+struct bpm_time {
+  uint16_t year;
+  uint8_t month;
+  uint8_t day;
+  uint8_t hours;
+  uint8_t minutes;
+  uint8_t seconds;
+};
+
+// Fields disabled in Kconfig are ignored by the encoder
+struct bpm_measurement {
+  // mmHg or kPa as selected by CONFIG_APP_BPM_UNIT_KPA
+  sfloat_t systolic;
+  sfloat_t diastolic;
+  sfloat_t mean_arterial;
+  struct bpm_time time_stamp;
+  sfloat_t pulse_rate;
+  uint8_t user_id;
+  uint16_t status;
+  // k_uptime_get() when measured. If set, time_stamp is filled in from the
+  // wall clock on submit, see bps_svc_submit_measurement().
+  int64_t taken_at;
+};
+
+// Append the measurement to buf in the Kconfig selected layout. Returns the
+// encoded length or -ENOMEM if buf has less than BPM_ENCODED_LEN tailroom.
+int bpm_encode(const struct bpm_measurement* m, struct net_buf_simple* buf);
+
+// Parse an encoded measurement with any combination of fields, e.g. one
+// stored by a build with other Kconfig choices. Absent fields are zeroed.
+// Returns its flags or -EINVAL if len does not match them.
+int bpm_decode(const uint8_t* data, size_t len, struct bpm_measurement* m);
+
+// Seconds since 1970 of a Date Time, handled as UTC. 0 if it is unknown.
+uint32_t bpm_time_to_secs(const struct bpm_time* t);
+
+// Overwrite the Time Stamp of an encoded measurement in place. Returns
+// -EINVAL if the measurement has none.
+int bpm_set_time_stamp(uint8_t* data, size_t len, const struct bpm_time* t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_BPM_H_ */
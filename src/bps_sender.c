@@ -0,0 +1,501 @@
+/** @file
+ *  @brief Flow controlled Blood Pressure Measurement sender
+ */
+
+#include "bps_sender.h"
+#include "log_ratelimit.h"
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/spinlock.h>
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "modules/conn_params.h"
+#include "modules/conn_tuning.h"
+#include "modules/eatt.h"
+#include "modules/record_store.h"
+#include "modules/trace.h"
+
+LOG_MODULE_REGISTER(bps_sender);
+
+#define QUEUE_LEN CONFIG_APP_BPS_SENDER_QUEUE_LEN
+#define MAX_IN_FLIGHT CONFIG_APP_BPS_SENDER_MAX_IN_FLIGHT
+
+BUILD_ASSERT(MAX_IN_FLIGHT <= ATOMIC_BITS, "One ind_slots_used bit per slot");
+BUILD_ASSERT(CONFIG_BT_MAX_CONN <= 8, "One queue_entry.peers bit per peer");
+
+static const struct bt_gatt_attr* bpm_attr;
+static bps_sender_space_cb space_cb;
+
+// One ring shared by all centrals. Every record is stored once and carries
+// the set of peers (bt_conn_index bits) still to receive it. Each peer reads
+// the ring through its own tail, a slot is free once every tail passed it.
+static struct queue_entry {
+  struct bps_record record;
+  uint8_t peers;
+} queue[QUEUE_LEN];
+static uint32_t head;
+static struct k_spinlock queue_lock;
+
+// Indications keep their params until confirmed. The stack copies the value
+// into its own buffer, so the params point straight into the ring.
+struct ind_slot {
+  struct bt_gatt_indicate_params params;
+  uint8_t peer;
+};
+
+static struct peer {
+  struct bt_conn* conn;
+  // Free running, the peer still has head - tail records to go through
+  uint32_t tail;
+  // Packets handed to the stack and not yet completed or confirmed
+  atomic_t in_flight;
+  bt_security_t security;
+  struct ind_slot ind_slots[MAX_IN_FLIGHT];
+  atomic_t ind_slots_used;
+  struct {
+    atomic_t sent;
+    atomic_t acked;
+    atomic_t dropped;
+  } stats;
+} peers[CONFIG_BT_MAX_CONN];
+
+static struct {
+  atomic_t sent;
+  atomic_t acked;
+  atomic_t dropped;
+  atomic_t retried;
+  atomic_t overflow;
+} stats;
+
+// Start of the current run of back-to-back records, for the rate log. The
+// rate is the aggregate over all peers served during the burst. Protected by
+// queue_lock, enqueue starts a burst from any thread.
+static int64_t burst_start;
+static uint32_t burst_sent;
+static uint8_t burst_peers;
+
+static void tx_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(tx_work, tx_work_fn);
+
+static inline void kick(void) {
+  k_work_reschedule(&tx_work, K_NO_WAIT);
+}
+
+static inline struct peer* peer_get(struct bt_conn* conn) {
+  return &peers[bt_conn_index(conn)];
+}
+
+// Caller holds queue_lock
+static uint32_t oldest_tail(void) {
+  uint32_t oldest = head;
+
+  for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+    if (peers[i].conn && head - peers[i].tail > head - oldest) {
+      oldest = peers[i].tail;
+    }
+  }
+  return oldest;
+}
+
+static void packet_done(struct peer* p) {
+  // Completions for a connection that is already gone may still trickle in
+  if (atomic_dec(&p->in_flight) <= 0) {
+    atomic_set(&p->in_flight, 0);
+  }
+  kick();
+}
+
+static void notify_done(struct bt_conn* conn, void* user_data) {
+  struct peer* p = peer_get(conn);
+
+  ARG_UNUSED(user_data);
+
+  trace_stage(TRACE_TX_COMPLETE);
+  atomic_inc(&stats.acked);
+  atomic_inc(&p->stats.acked);
+  packet_done(p);
+}
+
+static void indicate_done(struct bt_conn* conn,
+                          struct bt_gatt_indicate_params* params, uint8_t err) {
+  struct peer* p = peer_get(conn);
+
+  ARG_UNUSED(params);
+
+  if (err) {
+    atomic_inc(&stats.dropped);
+    atomic_inc(&p->stats.dropped);
+  } else {
+    trace_stage(TRACE_TX_COMPLETE);
+    atomic_inc(&stats.acked);
+    atomic_inc(&p->stats.acked);
+  }
+}
+
+static void indicate_destroy(struct bt_gatt_indicate_params* params) {
+  struct ind_slot* slot = CONTAINER_OF(params, struct ind_slot, params);
+  struct peer* p = &peers[slot->peer];
+
+  atomic_clear_bit(&p->ind_slots_used, slot - p->ind_slots);
+  packet_done(p);
+}
+
+static int send_indication(struct peer* p, struct bt_conn* conn,
+                           const struct bps_record* record) {
+  for (size_t i = 0; i < MAX_IN_FLIGHT; i++) {
+    if (atomic_test_and_set_bit(&p->ind_slots_used, i)) {
+      continue;
+    }
+
+    struct ind_slot* slot = &p->ind_slots[i];
+    int err;
+
+    slot->peer = p - peers;
+    slot->params = (struct bt_gatt_indicate_params){
+        .attr = bpm_attr,
+        .func = indicate_done,
+        .destroy = indicate_destroy,
+        .data = record->data,
+        .len = record->len,
+    };
+    EATT_SET_CHAN_OPT(&slot->params, conn, EATT_CLASS_LIVE);
+
+    err = bt_gatt_indicate(conn, &slot->params);
+    if (err) {
+      atomic_clear_bit(&p->ind_slots_used, i);
+    }
+    return err;
+  }
+
+  return -ENOMEM;
+}
+
+static int send_notification(struct bt_conn* conn,
+                             const struct bps_record* record) {
+  struct bt_gatt_notify_params params = {
+      .attr = bpm_attr,
+      .data = record->data,
+      .len = record->len,
+      .func = notify_done,
+  };
+
+  EATT_SET_CHAN_OPT(&params, conn, EATT_CLASS_LIVE);
+  return bt_gatt_notify_cb(conn, &params);
+}
+
+// Caller holds queue_lock
+static void advance(struct peer* p) {
+  queue[p->tail % QUEUE_LEN].peers &= ~BIT(p - peers);
+  p->tail++;
+}
+
+// Move past the record at the tail. False if the peer disconnected
+// meanwhile, its tail may already belong to a new central.
+static bool pop(struct peer* p, struct bt_conn* conn, bool sent) {
+  k_spinlock_key_t key = k_spin_lock(&queue_lock);
+  bool same = (p->conn == conn);
+
+  if (same) {
+    if (sent) {
+      burst_sent++;
+      burst_peers |= BIT(p - peers);
+    }
+    advance(p);
+  }
+  k_spin_unlock(&queue_lock, key);
+  return same;
+}
+
+// Skip everything queued for the peer. Records are only counted as dropped
+// when the central wanted them, not when it simply isn't subscribed.
+static size_t peer_drop_all(struct peer* p, bool count) {
+  k_spinlock_key_t key = k_spin_lock(&queue_lock);
+  size_t dropped = 0;
+
+  while (p->tail != head) {
+    dropped += !!(queue[p->tail % QUEUE_LEN].peers & BIT(p - peers));
+    advance(p);
+  }
+  k_spin_unlock(&queue_lock, key);
+
+  if (count) {
+    atomic_add(&stats.dropped, dropped);
+    atomic_add(&p->stats.dropped, dropped);
+  }
+  return dropped;
+}
+
+// Send what the link of one peer takes, returns true if queue space freed up
+static bool peer_send(struct peer* p) {
+  struct bt_conn* conn = NULL;
+  bool popped = false;
+  bool indicate;
+  uint8_t window;
+
+  // disconnected() clears and unrefs p->conn on the RX thread, work with
+  // our own reference. A NULL conn would send to every central.
+  k_spinlock_key_t key = k_spin_lock(&queue_lock);
+
+  if (p->conn) {
+    conn = bt_conn_ref(p->conn);
+  }
+  k_spin_unlock(&queue_lock, key);
+
+  if (!conn) {
+    return false;
+  }
+
+  // Notifications win when the central enabled both
+  indicate = !bt_gatt_is_subscribed(conn, bpm_attr, BT_GATT_CCC_NOTIFY);
+  if (indicate &&
+      !bt_gatt_is_subscribed(conn, bpm_attr, BT_GATT_CCC_INDICATE)) {
+    popped = peer_drop_all(p, false) > 0;
+    bt_conn_unref(conn);
+    return popped;
+  }
+
+  // Keep as many packets queued in the host as the negotiated link carries
+  // per connection event, so the controller sends them back to back.
+  window = conn_tuning_tx_window(conn, BPS_RECORD_MAX_LEN, MAX_IN_FLIGHT);
+  while (p->tail != head && atomic_get(&p->in_flight) < window) {
+    const struct queue_entry* entry = &queue[p->tail % QUEUE_LEN];
+    int err;
+
+    if (!(entry->peers & BIT(p - peers))) {
+      // Addressed to another central only
+      if (!pop(p, conn, false)) {
+        break;
+      }
+      popped = true;
+      continue;
+    }
+
+    atomic_inc(&p->in_flight);
+    err = indicate ? send_indication(p, conn, &entry->record)
+                   : send_notification(conn, &entry->record);
+
+    if (err == -ENOMEM || err == -ENOBUFS) {
+      atomic_dec(&p->in_flight);
+      atomic_inc(&stats.retried);
+      // A completion will kick us again, unless nothing is outstanding
+      if (atomic_get(&p->in_flight) == 0) {
+        k_work_schedule(&tx_work, K_MSEC(1));
+      }
+      break;
+    }
+
+    if (err) {
+      atomic_dec(&p->in_flight);
+      atomic_inc(&stats.dropped);
+      atomic_inc(&p->stats.dropped);
+      LOG_RATELIMIT(LOG_DBG, "Record dropped (err %d)", err);
+    } else {
+      trace_stage(TRACE_TX_HANDOFF);
+      atomic_inc(&stats.sent);
+      atomic_inc(&p->stats.sent);
+    }
+
+    if (!pop(p, conn, !err)) {
+      break;
+    }
+    popped = true;
+  }
+
+  bt_conn_unref(conn);
+  return popped;
+}
+
+static void tx_work_fn(struct k_work* work) {
+  bool popped = false;
+  bool pending;
+  int64_t start = 0;
+  uint32_t sent = 0;
+  uint8_t served = 0;
+
+  ARG_UNUSED(work);
+
+  for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+    if (bpm_attr) {
+      popped |= peer_send(&peers[i]);
+    }
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&queue_lock);
+
+  pending = (oldest_tail() != head);
+  if (!pending && burst_sent > 0) {
+    start = burst_start;
+    sent = burst_sent;
+    served = burst_peers;
+    burst_sent = 0;
+    burst_peers = 0;
+  }
+  k_spin_unlock(&queue_lock, key);
+
+  if (sent > 0) {
+    int64_t elapsed = MAX(k_uptime_get() - start, 1);
+
+    LOG_INF("Sent %u records to %u centrals in %lld ms (%lld records/s, "
+            "target %d)",
+            sent, POPCOUNT(served), elapsed, sent * 1000LL / elapsed,
+            CONFIG_APP_BPS_SENDER_TARGET_RATE);
+  }
+
+  conn_params_busy(pending);
+
+  if (popped && space_cb) {
+    space_cb();
+  }
+}
+
+void bps_sender_init(const struct bt_gatt_attr* attr,
+                     bps_sender_space_cb cb) {
+  bpm_attr = attr;
+  space_cb = cb;
+}
+
+int bps_sender_enqueue(struct bt_conn* conn, const uint8_t* data,
+                       size_t len) {
+  k_spinlock_key_t key;
+  uint8_t targets = 0;
+
+  if (len == 0 || len > BPS_RECORD_MAX_LEN) {
+    return -EINVAL;
+  }
+
+  key = k_spin_lock(&queue_lock);
+
+  if (conn) {
+    if (peer_get(conn)->conn == conn) {
+      targets = BIT(bt_conn_index(conn));
+    }
+  } else {
+    for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+      if (peers[i].conn) {
+        targets |= BIT(i);
+      }
+    }
+  }
+
+  if (!targets) {
+    k_spin_unlock(&queue_lock, key);
+    return -ENOTCONN;
+  }
+
+  uint32_t oldest = oldest_tail();
+
+  if (head - oldest >= QUEUE_LEN) {
+    k_spin_unlock(&queue_lock, key);
+    atomic_inc(&stats.overflow);
+    return -ENOMEM;
+  }
+
+  if (oldest == head && burst_sent == 0) {
+    burst_start = k_uptime_get();
+  }
+
+  struct queue_entry* entry = &queue[head % QUEUE_LEN];
+
+  entry->record.len = len;
+  memcpy(entry->record.data, data, len);
+  entry->peers = targets;
+  head++;
+  k_spin_unlock(&queue_lock, key);
+
+  trace_stage(TRACE_ENQUEUE);
+  conn_params_busy(true);
+  kick();
+  return 0;
+}
+
+size_t bps_sender_space(void) {
+  k_spinlock_key_t key = k_spin_lock(&queue_lock);
+  size_t space = QUEUE_LEN - (head - oldest_tail());
+
+  k_spin_unlock(&queue_lock, key);
+  return space;
+}
+
+size_t bps_sender_pending(struct bt_conn* conn) {
+  struct peer* p = peer_get(conn);
+  k_spinlock_key_t key = k_spin_lock(&queue_lock);
+  size_t pending = (p->conn == conn) ? head - p->tail : 0;
+
+  k_spin_unlock(&queue_lock, key);
+  return pending;
+}
+
+void bps_sender_get_stats(struct bps_sender_stats* out) {
+  out->sent = atomic_get(&stats.sent);
+  out->acked = atomic_get(&stats.acked);
+  out->dropped = atomic_get(&stats.dropped);
+  out->retried = atomic_get(&stats.retried);
+  out->overflow = atomic_get(&stats.overflow);
+}
+
+static void connected(struct bt_conn* conn, uint8_t err) {
+  struct peer* p;
+
+  if (err) {
+    return;
+  }
+
+  p = peer_get(conn);
+
+  k_spinlock_key_t key = k_spin_lock(&queue_lock);
+
+  // Only records queued from now on are for this central
+  p->conn = bt_conn_ref(conn);
+  p->tail = head;
+  k_spin_unlock(&queue_lock, key);
+
+  p->security = bt_conn_get_security(conn);
+  atomic_set(&p->in_flight, 0);
+  atomic_set(&p->stats.sent, 0);
+  atomic_set(&p->stats.acked, 0);
+  atomic_set(&p->stats.dropped, 0);
+}
+
+static void disconnected(struct bt_conn* conn, uint8_t reason) {
+  struct peer* p = peer_get(conn);
+
+  ARG_UNUSED(reason);
+
+  if (p->conn != conn) {
+    return;
+  }
+
+  LOG_INF("Central %u: %ld sent, %ld acked, %ld dropped, security L%u",
+          bt_conn_index(conn), atomic_get(&p->stats.sent),
+          atomic_get(&p->stats.acked), atomic_get(&p->stats.dropped),
+          p->security);
+
+  peer_drop_all(p, true);
+
+  k_spinlock_key_t key = k_spin_lock(&queue_lock);
+
+  p->conn = NULL;
+  k_spin_unlock(&queue_lock, key);
+
+  bt_conn_unref(conn);
+  kick();
+}
+
+static void security_changed(struct bt_conn* conn, bt_security_t level,
+                             enum bt_security_err err) {
+  if (!err) {
+    peer_get(conn)->security = level;
+  }
+}
+
+BT_CONN_CB_DEFINE(sender_conn_callbacks) = {
+    .connected = connected,
+    .disconnected = disconnected,
+    .security_changed = security_changed,
+};
@@ -0,0 +1,55 @@
+/** @file
+ *  @brief Flow controlled Blood Pressure Measurement sender
+ */
+
+#ifndef ST_BLE_BPS_SENDER_H_
+#define ST_BLE_BPS_SENDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/bluetooth/gatt.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct bps_sender_stats {
+  // Handed to the host stack
+  uint32_t sent;
+  // TX complete for notifications, confirmed for indications
+  uint32_t acked;
+  // Rejected by the stack, e.g. peer gone or not subscribed
+  uint32_t dropped;
+  // Host out of buffers, queued record kept and sent again later
+  uint32_t retried;
+  // Queue full on enqueue
+  uint32_t overflow;
+};
+
+// Called from the sender work item whenever queue space frees up
+typedef void (*bps_sender_space_cb)(void);
+
+// Cache the characteristic value attribute all records are sent on
+void bps_sender_init(const struct bt_gatt_attr* attr,
+                     bps_sender_space_cb space_cb);
+
+// Queue a measurement for one central, or for every connected central if
+// conn is NULL. The record is stored once and sent to each as notification or
+// indication depending on its CCC. Returns -ENOMEM if the queue is full and
+// -ENOTCONN if there is nobody to send it to.
+int bps_sender_enqueue(struct bt_conn* conn, const uint8_t* data, size_t len);
+
+// Free queue slots, bounded by the central furthest behind
+size_t bps_sender_space(void);
+
+// Records still queued for the given central
+size_t bps_sender_pending(struct bt_conn* conn);
+
+void bps_sender_get_stats(struct bps_sender_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_BPS_SENDER_H_ */
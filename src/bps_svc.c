@@ -0,0 +1,683 @@
+/** @file
+ *  @brief Blood Pressure Service
+ */
+
+#include "bps_svc.h"
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+
+#include "app_work.h"
+#include "bpm.h"
+#include "bps_sender.h"
+#include "log_ratelimit.h"
+#include "modules/button_state.h"
+#include "modules/cuff_pressure.h"
+#include "modules/eatt.h"
+#include "modules/record_store.h"
+#include "modules/trace.h"
+#include "modules/wall_clock.h"
+
+LOG_MODULE_REGISTER(bps_svc);
+
+static struct bt_uuid_16 bps_uuid = BT_UUID_INIT_16(BT_UUID_BPS_VAL);
+
+static struct bt_uuid_16 bpm_uuid = BT_UUID_INIT_16(BT_UUID_GATT_BPM_VAL);
+
+// Record Access Control Point
+static struct bt_uuid_16 racp_uuid = BT_UUID_INIT_16(0x2a52);
+
+static struct bt_uuid_16 icp_uuid = BT_UUID_INIT_16(0x2a36);
+
+// Index of the characteristic values in bps_svc.attrs
+#define BPM_ATTR_IDX 2
+#define RACP_ATTR_IDX 5
+#define ICP_ATTR_IDX 8
+
+// RACP specific ATT error codes
+#define RACP_ERR_IN_PROGRESS 0xfe
+#define RACP_ERR_CCC_CONFIG 0xfd
+
+// Any central subscribed, the sender checks each connection's own CCC
+static bool bpm_subscribed;
+
+BUILD_ASSERT(BPM_ENCODED_LEN <= BPS_RECORD_MAX_LEN, "BPM won't fit a record");
+
+// Sent when a bonded central subscribes, time stamped when it is sent
+static const struct bpm_measurement demo_measurement = {
+    .systolic = SFLOAT(128, 0),
+    .diastolic = SFLOAT(92, 0),
+    .mean_arterial = SFLOAT(104, 0),
+    .pulse_rate = SFLOAT(96, 0),
+    .user_id = 1,
+    .status = 0,
+};
+
+// Measurements left in the benchmark burst, see CONFIG_APP_BPS_BENCH_BURST
+static atomic_t bench_left;
+
+static void bench_work_fn(struct k_work* work);
+static K_WORK_DEFINE(bench_work, bench_work_fn);
+
+// Measurements bps_svc_submit() queued while the store was loading, see
+// record_store_early_seq()
+static atomic_t early_queued;
+
+// Latest measurement, returned on reads of the BPM characteristic
+static uint8_t bpm_value[BPM_ENCODED_LEN];
+static size_t bpm_value_len;
+
+// RACP procedure of one connection, one may run per connected central
+static struct racp_ctx {
+  atomic_t busy;
+  bool abort;
+  struct bt_conn* conn;
+  uint8_t opcode;
+  // Record cursor: next sequence number to queue
+  uint32_t next_seq;
+  uint32_t sent;
+  // All matching records are queued, waiting for the sender to drain
+  bool queued;
+  int err;
+  int64_t started;
+  uint8_t rsp[4];
+  struct bt_gatt_indicate_params ind_params;
+  struct k_work_delayable work;
+} racp_ctx[CONFIG_BT_MAX_CONN];
+
+#if IS_ENABLED(CONFIG_APP_WALL_CLOCK)
+// Measurements stored before the clock was synced, oldest first. Those
+// queued while the store was loading come first and are early, seq being
+// their index for record_store_early_seq() until resolved.
+static struct backdate_entry {
+  uint32_t seq;
+  bool early;
+  int64_t taken_at;
+} backdate[CONFIG_APP_WALL_CLOCK_BACKDATE_MAX];
+static size_t backdate_first;
+static size_t backdate_count;
+static K_MUTEX_DEFINE(backdate_lock);
+
+static inline struct backdate_entry* backdate_at(size_t i) {
+  return &backdate[(backdate_first + i) % ARRAY_SIZE(backdate)];
+}
+
+// Only the latest ones are kept, older records stay without a time stamp
+static void backdate_remember(uint32_t seq, bool early, int64_t taken_at) {
+  k_mutex_lock(&backdate_lock, K_FOREVER);
+  if (backdate_count == ARRAY_SIZE(backdate)) {
+    backdate_first = (backdate_first + 1) % ARRAY_SIZE(backdate);
+    backdate_count--;
+  }
+  *backdate_at(backdate_count++) =
+      (struct backdate_entry){seq, early, taken_at};
+  k_mutex_unlock(&backdate_lock);
+}
+
+// Caller holds backdate_lock. Returns false while the store is still loading
+// and the early records have no sequence number yet.
+static bool backdate_resolve(void) {
+  for (size_t i = 0; i < backdate_count && backdate_at(i)->early; i++) {
+    int seq = record_store_early_seq(backdate_at(i)->seq);
+
+    if (seq == 0) {
+      return false;
+    }
+    // One that was not stored keeps seq 0 and matches no record
+    backdate_at(i)->seq = MAX(seq, 0);
+    backdate_at(i)->early = false;
+  }
+
+  while (backdate_count > 0 && backdate_at(0)->seq == 0) {
+    backdate_first = (backdate_first + 1) % ARRAY_SIZE(backdate);
+    backdate_count--;
+  }
+  return true;
+}
+
+struct backdate_walk {
+  size_t next;
+  uint32_t done;
+};
+
+// Records come in sequence order, like the entries
+static bool backdate_cb(uint32_t seq, struct bps_record* record,
+                        void* user_data) {
+  struct backdate_walk* walk = user_data;
+  struct bpm_time t;
+
+  while (walk->next < backdate_count && backdate_at(walk->next)->seq < seq) {
+    walk->next++;
+  }
+  if (walk->next == backdate_count || backdate_at(walk->next)->seq != seq ||
+      wall_clock_to_bpm_time(backdate_at(walk->next)->taken_at, &t) ||
+      bpm_set_time_stamp(record->data, record->len, &t)) {
+    return false;
+  }
+
+  walk->done++;
+  return true;
+}
+
+// All at once: each batch in flash is rewritten a single time
+static void time_synced(void) {
+  struct backdate_walk walk = {0};
+  int err;
+
+  if (!IS_ENABLED(CONFIG_APP_RECORD_STORE)) {
+    return;
+  }
+
+  k_mutex_lock(&backdate_lock, K_FOREVER);
+  // Otherwise bps_svc_records_loaded() comes back once it can
+  if (backdate_resolve() && backdate_count > 0) {
+    err = record_store_modify(backdate_at(0)->seq,
+                              backdate_at(backdate_count - 1)->seq,
+                              backdate_cb, &walk);
+    LOG_INF("Back-dated %u of %zu records (err %d)", walk.done,
+            backdate_count, err);
+    backdate_count = 0;
+  }
+  k_mutex_unlock(&backdate_lock);
+}
+#else
+static inline void backdate_remember(uint32_t seq, bool early,
+                                     int64_t taken_at) {}
+static inline void time_synced(void) {}
+#endif
+
+// Encode m, time stamped from the wall clock if m->taken_at is set. unsynced,
+// if given, tells whether the clock could not stamp it yet.
+static int encode_stamped(const struct bpm_measurement* m,
+                          struct net_buf_simple* buf, bool* unsynced) {
+  struct bpm_measurement stamped = *m;
+  bool late = false;
+
+  if (m->taken_at) {
+    late = wall_clock_to_bpm_time(m->taken_at, &stamped.time_stamp) != 0;
+  }
+  if (unsynced) {
+    *unsynced = late;
+  }
+
+  int err = bpm_encode(&stamped, buf);
+
+  return err < 0 ? err : 0;
+}
+
+static void on_bpm_ccc(const struct app_work_event* evt) {
+  LOG_INF("%s %s",
+          (evt->ccc_value == BT_GATT_CCC_INDICATE) ? "Indication"
+                                                   : "Notification",
+          evt->ccc_value ? "enabled" : "disabled");
+
+  // Only sent, not stored: it is no measurement the user took. Only to the
+  // central that subscribed, the others have had theirs.
+  if (atomic_test_bit(&get_status()->status_bits, BONDED) && evt->ccc_value) {
+    NET_BUF_SIMPLE_DEFINE(buf, BPM_ENCODED_LEN);
+    struct bpm_measurement m = demo_measurement;
+
+    m.taken_at = k_uptime_get();
+    if (encode_stamped(&m, &buf, NULL) == 0) {
+      bps_sender_enqueue(evt->conn, buf.data, buf.len);
+    }
+  }
+}
+
+// Per central, cfg_changed only sees the combined value of all of them
+static ssize_t vnd_ccc_cfg_write(struct bt_conn* conn,
+                                 const struct bt_gatt_attr* attr,
+                                 uint16_t value) {
+  uint32_t start = k_cycle_get_32();
+  const struct app_work_event evt = {
+      .type = APP_WORK_BPM_CCC, .conn = conn, .ccc_value = value};
+
+  ARG_UNUSED(attr);
+  app_work_submit(on_bpm_ccc, &evt);
+  app_work_cb_timing("bpm_ccc", start);
+  return sizeof(value);
+}
+
+static void vnd_ccc_cfg_changed(const struct bt_gatt_attr* attr,
+                                uint16_t value) {
+  ARG_UNUSED(attr);
+  bpm_subscribed = (value != 0);
+  if (bpm_subscribed) {
+    trace_begin(TRACE_PATH_NOTIFY);
+  }
+
+  if (CONFIG_APP_BPS_BENCH_BURST > 0) {
+    atomic_set(&bench_left, bpm_subscribed ? CONFIG_APP_BPS_BENCH_BURST : 0);
+    k_work_submit(&bench_work);
+  }
+}
+
+static struct _bt_gatt_ccc bpm_ccc =
+    BT_GATT_CCC_INITIALIZER(vnd_ccc_cfg_changed, vnd_ccc_cfg_write, NULL);
+
+// Fill the sender queue, the space callback brings us back for the rest
+static void bench_work_fn(struct k_work* work) {
+  NET_BUF_SIMPLE_DEFINE(buf, BPM_ENCODED_LEN);
+
+  ARG_UNUSED(work);
+
+  bpm_encode(&demo_measurement, &buf);
+  while (atomic_get(&bench_left) > 0 &&
+         bps_sender_enqueue(NULL, buf.data, buf.len) == 0) {
+    atomic_dec(&bench_left);
+  }
+}
+
+static void racp_ccc_cfg_changed(const struct bt_gatt_attr* attr,
+                                 uint16_t value) {
+  ARG_UNUSED(attr);
+  LOG_DBG("RACP indication %s",
+          value == BT_GATT_CCC_INDICATE ? "enabled" : "disabled");
+}
+
+static void icp_ccc_cfg_changed(const struct bt_gatt_attr* attr,
+                                uint16_t value) {
+  ARG_UNUSED(attr);
+  LOG_DBG("Intermediate Cuff Pressure notification %s",
+          value == BT_GATT_CCC_NOTIFY ? "enabled" : "disabled");
+
+  // Stands in for cuff inflation until there is a real pressure sensor
+  if (value == BT_GATT_CCC_NOTIFY) {
+    cuff_pressure_start();
+  } else {
+    cuff_pressure_stop();
+  }
+}
+
+static ssize_t bpm_read(struct bt_conn* conn, const struct bt_gatt_attr* attr,
+                        void* buf, uint16_t len, uint16_t offset) {
+  return bt_gatt_attr_read(conn, attr, buf, len, offset, bpm_value,
+                           bpm_value_len);
+}
+
+static ssize_t racp_write(struct bt_conn* conn, const struct bt_gatt_attr* attr,
+                          const void* buf, uint16_t len, uint16_t offset,
+                          uint8_t flags);
+
+/* Blood Pressure Primary Service Declaration */
+BT_GATT_SERVICE_DEFINE(
+    bps_svc, BT_GATT_PRIMARY_SERVICE(&bps_uuid),
+    BT_GATT_CHARACTERISTIC(&bpm_uuid.uuid,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_INDICATE |
+                               BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_READ, bpm_read, NULL, NULL),
+    // Notify need to enable CCC (Client Characteristic Configuration) Declaration
+    BT_GATT_CCC_MANAGED(&bpm_ccc, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+    BT_GATT_CHARACTERISTIC(&racp_uuid.uuid,
+                           BT_GATT_CHRC_WRITE | BT_GATT_CHRC_INDICATE,
+                           BT_GATT_PERM_WRITE_ENCRYPT, NULL, racp_write,
+                           NULL),
+    BT_GATT_CCC(racp_ccc_cfg_changed,
+                BT_GATT_PERM_READ | BT_GATT_PERM_WRITE_ENCRYPT),
+    BT_GATT_CHARACTERISTIC(&icp_uuid.uuid, BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_NONE, NULL, NULL, NULL),
+    BT_GATT_CCC(icp_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE), );
+
+// early, if given, is set to the record's index among those queued while the
+// store was loading, -1 if it was not queued
+static int submit(const uint8_t* data, size_t len, int* early) {
+  int seq = 0;
+
+  if (early) {
+    *early = -1;
+  }
+
+  if (len <= sizeof(bpm_value)) {
+    memcpy(bpm_value, data, len);
+    bpm_value_len = len;
+  }
+
+  if (IS_ENABLED(CONFIG_APP_RECORD_STORE)) {
+    seq = record_store_append(data, len);
+    if (seq < 0) {
+      LOG_ERR("Cannot store measurement (err %d)", seq);
+    } else if (seq == 0) {
+      int index = atomic_inc(&early_queued);
+
+      if (early) {
+        *early = index;
+      }
+    }
+  }
+
+  if (bpm_subscribed && bps_sender_enqueue(NULL, data, len) == -ENOMEM) {
+    LOG_RATELIMIT(LOG_WRN, "Measurement %d not sent, queue full", seq);
+  }
+
+  return seq;
+}
+
+int bps_svc_submit(const uint8_t* data, size_t len) {
+  return submit(data, len, NULL);
+}
+
+int bps_svc_submit_measurement(const struct bpm_measurement* m) {
+  NET_BUF_SIMPLE_DEFINE(buf, BPM_ENCODED_LEN);
+  bool unsynced;
+  int err, seq, early;
+
+  err = encode_stamped(m, &buf, &unsynced);
+  if (err < 0) {
+    return err;
+  }
+
+  seq = submit(buf.data, buf.len, &early);
+  if (IS_ENABLED(CONFIG_APP_BPM_TIME_STAMP) && unsynced) {
+    if (seq > 0) {
+      backdate_remember(seq, false, m->taken_at);
+    } else if (early >= 0) {
+      backdate_remember(early, true, m->taken_at);
+    }
+  }
+  return seq;
+}
+
+void bps_svc_records_loaded(void) {
+  if (wall_clock_synced()) {
+    time_synced();
+  }
+}
+
+static void racp_ind_destroy(struct bt_gatt_indicate_params* params) {
+  struct racp_ctx* racp = CONTAINER_OF(params, struct racp_ctx, ind_params);
+
+  atomic_clear(&racp->busy);
+}
+
+static void racp_finish(struct racp_ctx* racp, uint8_t opcode,
+                        const uint8_t* rsp, size_t len) {
+  int err;
+
+  memcpy(racp->rsp, rsp, len);
+  racp->ind_params.attr = &bps_svc.attrs[RACP_ATTR_IDX];
+  racp->ind_params.func = NULL;
+  racp->ind_params.destroy = racp_ind_destroy;
+  racp->ind_params.data = racp->rsp;
+  racp->ind_params.len = len;
+  EATT_SET_CHAN_OPT(&racp->ind_params, racp->conn, EATT_CLASS_LIVE);
+
+  err = bt_gatt_indicate(racp->conn, &racp->ind_params);
+  if (err) {
+    LOG_WRN("RACP 0x%02x response failed (err %d)", opcode, err);
+  }
+
+  if (racp->conn) {
+    bt_conn_unref(racp->conn);
+    racp->conn = NULL;
+  }
+
+  if (err) {
+    atomic_clear(&racp->busy);
+  }
+}
+
+static void racp_respond(struct racp_ctx* racp, uint8_t req_opcode,
+                         uint8_t code) {
+  const uint8_t rsp[] = {RACP_OP_RESPONSE, RACP_OPERATOR_NULL, req_opcode,
+                         code};
+
+  racp_finish(racp, req_opcode, rsp, sizeof(rsp));
+}
+
+static void racp_respond_count(struct racp_ctx* racp, uint32_t count) {
+  uint8_t rsp[4] = {RACP_OP_COUNT_RESPONSE, RACP_OPERATOR_NULL};
+
+  sys_put_le16(MIN(count, UINT16_MAX), &rsp[2]);
+  racp_finish(racp, RACP_OP_REPORT_COUNT, rsp, sizeof(rsp));
+}
+
+static bool racp_send_cb(uint32_t seq, const struct bps_record* record,
+                         void* user_data) {
+  struct racp_ctx* racp = user_data;
+
+  if (racp->abort) {
+    return false;
+  }
+
+  racp->err = bps_sender_enqueue(racp->conn, record->data, record->len);
+  if (racp->err) {
+    return false;
+  }
+
+  racp->next_seq = seq + 1;
+  racp->sent++;
+  return true;
+}
+
+static void racp_work_fn(struct k_work* work) {
+  struct racp_ctx* racp = CONTAINER_OF(k_work_delayable_from_work(work),
+                                       struct racp_ctx, work);
+
+  if (!IS_ENABLED(CONFIG_APP_RECORD_STORE)) {
+    return;
+  }
+
+  if (!racp->queued) {
+    racp->err = 0;
+    record_store_foreach(racp->next_seq, racp_send_cb, racp);
+    racp->queued = (racp->err == 0);
+  }
+
+  if (racp->abort) {
+    LOG_INF("RACP aborted after %u records", racp->sent);
+    racp_respond(racp, RACP_OP_ABORT, RACP_RSP_SUCCESS);
+    return;
+  }
+
+  // Queue full, or the last records are still in flight: the sender calls
+  // sender_space_cb() once it has made room. The response must not overtake
+  // the records.
+  if (racp->err == -ENOMEM ||
+      (racp->queued && bps_sender_pending(racp->conn) > 0)) {
+    return;
+  }
+
+  if (racp->err) {
+    LOG_WRN("RACP stopped after %u records (err %d)", racp->sent, racp->err);
+    racp_respond(racp, racp->opcode, RACP_RSP_PROCEDURE_NOT_COMPLETED);
+    return;
+  }
+
+  int64_t elapsed = MAX(k_uptime_get() - racp->started, 1);
+
+  LOG_INF("RACP sent %u records in %lld ms (%lld records/s)", racp->sent,
+          elapsed, racp->sent * 1000LL / elapsed);
+  racp_respond(racp, racp->opcode,
+               racp->sent ? RACP_RSP_SUCCESS : RACP_RSP_NO_RECORDS);
+}
+
+static void sender_space_cb(void) {
+  if (atomic_get(&bench_left) > 0) {
+    k_work_submit(&bench_work);
+  }
+
+  for (size_t i = 0; i < ARRAY_SIZE(racp_ctx); i++) {
+    if (atomic_get(&racp_ctx[i].busy) && racp_ctx[i].conn) {
+      k_work_reschedule(&racp_ctx[i].work, K_NO_WAIT);
+    }
+  }
+}
+
+// The RACP Sequence Number filter is a uint16. The store holds fewer than
+// 2^16 records, so all of them are among the last 2^16 sequence numbers and
+// the operand is taken as the newest seq with those low 16 bits.
+BUILD_ASSERT(!IS_ENABLED(CONFIG_APP_RECORD_STORE) ||
+                 CONFIG_APP_RECORD_STORE_BATCH_SIZE *
+                         CONFIG_APP_RECORD_STORE_BATCH_COUNT <=
+                     UINT16_MAX,
+             "RACP sequence numbers can't address the whole store");
+
+static uint32_t racp_seq_expand(uint16_t seq) {
+  uint32_t last = 0;
+  uint32_t full;
+
+  if (IS_ENABLED(CONFIG_APP_RECORD_STORE)) {
+    last = record_store_last_seq();
+  }
+
+  full = (last & ~(uint32_t)UINT16_MAX) | seq;
+  if (full > last && full > UINT16_MAX) {
+    full -= UINT16_MAX + 1;
+  }
+  return full;
+}
+
+// Decode the operator and operand into the first sequence number to report
+static uint8_t racp_parse_filter(const uint8_t* req, uint16_t len,
+                                 uint32_t* from_seq) {
+  switch (req[1]) {
+    case RACP_OPERATOR_ALL:
+      if (len != 2) {
+        return RACP_RSP_INVALID_OPERAND;
+      }
+      *from_seq = 0;
+      return RACP_RSP_SUCCESS;
+    case RACP_OPERATOR_GREATER_EQUAL:
+      if (len != 5) {
+        return RACP_RSP_INVALID_OPERAND;
+      }
+      if (req[2] != RACP_FILTER_SEQ) {
+        return RACP_RSP_FILTER_NOT_SUPPORTED;
+      }
+      *from_seq = racp_seq_expand(sys_get_le16(&req[3]));
+      return RACP_RSP_SUCCESS;
+    case RACP_OPERATOR_NULL:
+      return RACP_RSP_INVALID_OPERATOR;
+    default:
+      return RACP_RSP_OPERATOR_NOT_SUPPORTED;
+  }
+}
+
+static ssize_t racp_write(struct bt_conn* conn, const struct bt_gatt_attr* attr,
+                          const void* buf, uint16_t len, uint16_t offset,
+                          uint8_t flags) {
+  struct racp_ctx* racp = &racp_ctx[bt_conn_index(conn)];
+  const uint8_t* req = buf;
+  uint32_t from_seq = 0;
+  uint8_t code;
+
+  ARG_UNUSED(flags);
+
+  if (offset) {
+    return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+  }
+  if (len < 2) {
+    return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+  }
+  if (!bt_gatt_is_subscribed(conn, attr, BT_GATT_CCC_INDICATE)) {
+    return BT_GATT_ERR(RACP_ERR_CCC_CONFIG);
+  }
+
+  if (req[0] == RACP_OP_ABORT) {
+    if (atomic_get(&racp->busy)) {
+      // The procedure already ended and only its response is pending, there
+      // is nothing left to abort
+      if (!racp->conn) {
+        return BT_GATT_ERR(RACP_ERR_IN_PROGRESS);
+      }
+      racp->abort = true;
+      return len;
+    }
+  }
+
+  if (!atomic_cas(&racp->busy, 0, 1)) {
+    return BT_GATT_ERR(RACP_ERR_IN_PROGRESS);
+  }
+
+  racp->conn = bt_conn_ref(conn);
+  racp->abort = false;
+
+  if (!IS_ENABLED(CONFIG_APP_RECORD_STORE)) {
+    racp_respond(racp, req[0], RACP_RSP_OPCODE_NOT_SUPPORTED);
+    return len;
+  }
+
+  switch (req[0]) {
+    case RACP_OP_REPORT_RECORDS:
+      code = racp_parse_filter(req, len, &from_seq);
+      if (code != RACP_RSP_SUCCESS) {
+        racp_respond(racp, req[0], code);
+        break;
+      }
+      racp->opcode = req[0];
+      racp->next_seq = from_seq;
+      racp->sent = 0;
+      racp->queued = false;
+      racp->started = k_uptime_get();
+      k_work_schedule(&racp->work, K_NO_WAIT);
+      break;
+    case RACP_OP_REPORT_COUNT:
+      code = racp_parse_filter(req, len, &from_seq);
+      if (code != RACP_RSP_SUCCESS) {
+        racp_respond(racp, req[0], code);
+      } else {
+        racp_respond_count(racp, record_store_count(from_seq));
+      }
+      break;
+    case RACP_OP_ABORT:
+      // Nothing running
+      racp_respond(racp, req[0], RACP_RSP_SUCCESS);
+      break;
+    default:
+      racp_respond(racp, req[0], RACP_RSP_OPCODE_NOT_SUPPORTED);
+      break;
+  }
+
+  return len;
+}
+
+int bps_svc_init(void) {
+  char str[BT_UUID_STR_LEN];
+
+  bt_uuid_to_str(&bpm_uuid.uuid, str, sizeof(str));
+  LOG_INF("Indicate BPS attr %p (UUID %s)",
+          (void*)&bps_svc.attrs[BPM_ATTR_IDX], str);
+
+  for (size_t i = 0; i < ARRAY_SIZE(racp_ctx); i++) {
+    k_work_init_delayable(&racp_ctx[i].work, racp_work_fn);
+  }
+
+  bps_sender_init(&bps_svc.attrs[BPM_ATTR_IDX], sender_space_cb);
+  cuff_pressure_init(&bps_svc.attrs[ICP_ATTR_IDX]);
+  wall_clock_init(time_synced);
+
+  return 0;
+}
+
+#if IS_ENABLED(CONFIG_APP_BPS_SHELL)
+static int cmd_bps_measure(const struct shell* sh, size_t argc, char** argv) {
+  struct bpm_measurement m = demo_measurement;
+  int seq;
+
+  m.taken_at = k_uptime_get();
+  seq = bps_svc_submit_measurement(&m);
+  if (seq < 0) {
+    shell_error(sh, "Measurement not submitted (err %d)", seq);
+    return seq;
+  }
+  shell_print(sh, "Measurement %d submitted", seq);
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    bps_cmds,
+    SHELL_CMD(measure, NULL, "Store and send the demo measurement now",
+              cmd_bps_measure),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(bps, &bps_cmds, "Blood Pressure Service", NULL);
+#endif
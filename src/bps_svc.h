@@ -0,0 +1,69 @@
+/** @file
+ *  @brief Blood Pressure Service
+ */
+
+#ifndef ST_BLE_BPS_SVC_H_
+#define ST_BLE_BPS_SVC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bpm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Record Access Control Point op codes (GSS, shared with the Glucose service)
+enum racp_opcode {
+  RACP_OP_REPORT_RECORDS = 0x01,
+  RACP_OP_ABORT = 0x03,
+  RACP_OP_REPORT_COUNT = 0x04,
+  RACP_OP_COUNT_RESPONSE = 0x05,
+  RACP_OP_RESPONSE = 0x06,
+};
+
+enum racp_operator {
+  RACP_OPERATOR_NULL = 0x00,
+  RACP_OPERATOR_ALL = 0x01,
+  // Operand: filter type RACP_FILTER_SEQ followed by a uint16 sequence number
+  RACP_OPERATOR_GREATER_EQUAL = 0x03,
+};
+
+#define RACP_FILTER_SEQ 0x01
+
+enum racp_response {
+  RACP_RSP_SUCCESS = 0x01,
+  RACP_RSP_OPCODE_NOT_SUPPORTED = 0x02,
+  RACP_RSP_INVALID_OPERATOR = 0x03,
+  RACP_RSP_OPERATOR_NOT_SUPPORTED = 0x04,
+  RACP_RSP_INVALID_OPERAND = 0x05,
+  RACP_RSP_NO_RECORDS = 0x06,
+  RACP_RSP_ABORT_FAILED = 0x07,
+  RACP_RSP_PROCEDURE_NOT_COMPLETED = 0x08,
+  RACP_RSP_FILTER_NOT_SUPPORTED = 0x09,
+};
+
+// Store a Blood Pressure Measurement and notify it to a subscribed central.
+// Returns the record sequence number, 0 while the store is still loading
+// (see record_store_append()) or negative errno.
+int bps_svc_submit(const uint8_t* data, size_t len);
+
+// Encode a measurement in the Kconfig selected layout and submit it. If
+// m->taken_at is set the Time Stamp comes from the wall clock, measurements
+// taken before it is synced are back-dated in the store once it is.
+int bps_svc_submit_measurement(const struct bpm_measurement* m);
+
+// Call once record_store_init() returned. Back-dates the measurements queued
+// while it was loading if the clock was synced meanwhile.
+void bps_svc_records_loaded(void);
+
+// Set up the senders, call before advertising. Stored records are restored
+// separately by record_store_init().
+int bps_svc_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_BPS_SVC_H_ */
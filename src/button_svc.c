@@ -29,26 +29,35 @@ int button_init(gpio_callback_handler_t handler)
 	int ret;
 
 	if (!gpio_is_ready_dt(&button)) {
-		printk("Error: button GPIO device %s is not ready",
+		LOG_ERR("Button GPIO device %s is not ready",
 			button.port->name);
 		return -ENODEV;
 	}
 
 	ret = gpio_pin_configure_dt(&button, GPIO_INPUT);
 	if (ret != 0) {
-		printk("Error %d: can't configure button on GPIO %s pin %d",
-			ret, button.port->name, button.pin);
+		LOG_ERR("Cannot configure button on GPIO %s pin %d (err %d)",
+			button.port->name, button.pin, ret);
 		return ret;
-
 	}
 
 	gpio_init_callback(&gpio_cb, handler, BIT(button.pin));
 	gpio_add_callback(button.port, &gpio_cb);
 	ret = gpio_pin_interrupt_configure_dt(&button, GPIO_INT_EDGE_TO_ACTIVE);
 	if (ret != 0) {
-		printk("Error %d: can't configure button interrupt on "
-			"GPIO %s pin %d", ret, button.port->name, button.pin);
+		LOG_ERR("Cannot configure button interrupt on GPIO %s pin %d "
+			"(err %d)", button.port->name, button.pin, ret);
 		return ret;
 	}
 	return 0;
 }
+
+int button_interrupt_configure(gpio_flags_t flags)
+{
+	return gpio_pin_interrupt_configure_dt(&button, flags);
+}
+
+int button_get(void)
+{
+	return gpio_pin_get_dt(&button);
+}
@@ -19,6 +19,12 @@ extern "C" {
 
 int button_init(gpio_callback_handler_t handler);
 
+/* Change the interrupt set up by button_init(), e.g. GPIO_INT_DISABLE */
+int button_interrupt_configure(gpio_flags_t flags);
+
+/* 1 when pressed, 0 when released, or a negative error code */
+int button_get(void);
+
 #ifdef __cplusplus
 }
 #endif
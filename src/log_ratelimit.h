@@ -0,0 +1,41 @@
+/** @file
+ *  @brief Rate limited logging for hot paths
+ */
+
+#ifndef ST_BLE_LOG_RATELIMIT_H_
+#define ST_BLE_LOG_RATELIMIT_H_
+
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Log through _log (LOG_WRN, LOG_DBG, ...) at most once per
+// CONFIG_APP_LOG_RATELIMIT_MS from this call site, with the number of calls
+// suppressed since. Unlocked: concurrent callers may lose a count, which is
+// fine for a diagnostic. The arguments are only evaluated when the line is
+// logged, keep side effects out of them.
+#define LOG_RATELIMIT(_log, _fmt, ...)                                  \
+  do {                                                                  \
+    static int64_t _rl_last = -CONFIG_APP_LOG_RATELIMIT_MS;             \
+    static uint32_t _rl_suppressed;                                     \
+    int64_t _rl_now = k_uptime_get();                                   \
+                                                                        \
+    if (_rl_now - _rl_last >= CONFIG_APP_LOG_RATELIMIT_MS) {            \
+      _log(_fmt " (%u suppressed)", ##__VA_ARGS__, _rl_suppressed);     \
+      _rl_last = _rl_now;                                               \
+      _rl_suppressed = 0;                                               \
+    } else {                                                            \
+      _rl_suppressed++;                                                 \
+    }                                                                   \
+  } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_LOG_RATELIMIT_H_ */
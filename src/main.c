@@ -3,7 +3,6 @@
 #include <string.h>
 #include <zephyr/kernel.h>
 #include <zephyr/sys/byteorder.h>
-#include <zephyr/sys/printk.h>
 #include <zephyr/types.h>
 
 #include <zephyr/settings/settings.h>
@@ -24,7 +23,16 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/sys/reboot.h>
 
+#include "advertising.h"
+#include "app_state.h"
+#include "app_work.h"
+#include "bps_svc.h"
 #include "modules/button_state.h"
+#include "modules/conn_tuning.h"
+#include "modules/load_gen.h"
+#include "modules/peer_cache.h"
+#include "modules/record_store.h"
+#include "modules/trace.h"
 
 #define MODULE main
 #include <caf/events/module_state_event.h>
@@ -35,133 +43,87 @@ LOG_MODULE_REGISTER(MODULE);
 #define CENTRAL_CON_STATUS_LED DK_LED2
 #define PERIPHERAL_CONN_STATUS_LED DK_LED3
 
-static struct bt_uuid_16 bps_uuid = BT_UUID_INIT_16(BT_UUID_BPS_VAL);
+/* Connected centrals, up to CONFIG_BT_MAX_CONN */
+static atomic_t conn_count;
 
-static struct bt_uuid_16 bpm_uuid = BT_UUID_INIT_16(BT_UUID_GATT_BPM_VAL);
-
-#define VND_MAX_LEN 21
-
-/* BLE connection */
-struct bt_conn* ble_conn;
-
-static size_t send_count = 0;
-static uint8_t simulate_vnd;
 static bt_addr_le_t bond_addr;
-static struct bt_le_adv_param adv_param;
 
 static struct device_status* device_status_ptr = NULL;
 
-static void notify_bps(void);
-
-static uint8_t vnd_value[VND_MAX_LEN] = {
-    // 1e 80 00 5c 00 68 00 e8 07 04 12 12 28 00 60 00
-    // 01 00 00 00 00
-    // Flags bit =>  0001 1110
-    //    bit 0 mmHg/kPa = 0 mmHg
-    //    bit 1 Time Stamp = 1 enable
-    //    bit 2 Pulse Rate = 1 enable
-    //    bit 3 User ID = 1 enable
-    //    bit 4 Measurement Status = 1 enable
-    // Systolic 80 00 => 128
-    // Diastolic 5c 00 => 92
-    // MeanAP 68 00 => 104
-    // TimeStamp e8 07 04 12 12 28 00
-    //    year 07e8 => 2024
-    //    month 04 => 4
-    //    day 12 => 18
-    //    hour 12 => 18
-    //    minute 28 => 40
-    //    second 00 => 0
-    // PulseRate 60 00 => 96
-    // Other 01 00 00 00 00
-    0x1e, 0x80, 0x00, 0x5c, 0x00, 0x68, 0x00, 0xe8, 0x07, 0x04, 0x12,
-    0x12, 0x28, 0x00, 0x60, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00};
-
-static void vnd_ccc_cfg_changed(const struct bt_gatt_attr* attr,
-                                uint16_t value) {
-  ARG_UNUSED(attr);
-  simulate_vnd = (value == BT_GATT_CCC_NOTIFY) ? 1 : 0;
-  printk("Notification %s\n", simulate_vnd ? "enabled" : "disabled");
-
-  if (atomic_test_bit(&device_status_ptr->status_bits, BONDED) &&
-      simulate_vnd) {
-    notify_bps();
-  }
-}
-
-/* Blood Pressure Primary Service Declaration */
-BT_GATT_SERVICE_DEFINE(
-    bps_svc, BT_GATT_PRIMARY_SERVICE(&bps_uuid),
-    BT_GATT_CHARACTERISTIC(&bpm_uuid.uuid,
-                           BT_GATT_CHRC_READ | BT_GATT_CHRC_INDICATE |
-                               BT_GATT_CHRC_NOTIFY,
-                           BT_GATT_PERM_READ, NULL, NULL, vnd_value),
-    // Notify need to enable CCC (Client Characteristic Configuration) Declaration
-    BT_GATT_CCC(vnd_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE), );
-
-static const struct bt_data ad[] = {
-    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
-    BT_DATA_BYTES(BT_DATA_UUID16_ALL, BT_UUID_16_ENCODE(BT_UUID_BPS_VAL),
-                  BT_UUID_16_ENCODE(BT_UUID_BAS_VAL),
-                  BT_UUID_16_ENCODE(BT_UUID_CTS_VAL)),
-};
-
-static void notify_bps(void) {
-  printk("Sending notification\n");
-  struct bt_gatt_attr* notify_ccc =
-      bt_gatt_find_by_uuid(bps_svc.attrs, bps_svc.attr_count, &bpm_uuid.uuid);
-  bt_gatt_notify(NULL, notify_ccc, &vnd_value, sizeof(vnd_value));
-  send_count++;
-  printk("Notification sent count: %d\n", send_count);
-}
-
 void mtu_updated(struct bt_conn* conn, uint16_t tx, uint16_t rx) {
-  printk("Updated MTU: TX: %d RX: %d bytes\n", tx, rx);
+  LOG_INF("Updated MTU: TX: %d RX: %d bytes", tx, rx);
 }
 
 static struct bt_gatt_cb gatt_callbacks = {.att_mtu_updated = mtu_updated};
 
-static void connected(struct bt_conn* conn, uint8_t err) {
-  if (err) {
-    printk("Connection failed (err 0x%02x)\n", err);
-  } else {
-    // show connection source mac address
-    char addr[BT_ADDR_LE_STR_LEN];
-    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
-    printk("Connected %s\n", addr);
+// Bluetooth callbacks run on the stack's RX thread: update the status bits
+// and hand everything else to the application work queue.
+static void on_connected(const struct app_work_event* evt) {
+  char addr[BT_ADDR_LE_STR_LEN];
 
-    atomic_set_bit(&device_status_ptr->status_bits, CONNECTED);
+  if (evt->err) {
+    LOG_WRN("Connection failed (err 0x%02x)", evt->err);
+    return;
+  }
 
-    if (!ble_conn) {
-      ble_conn = bt_conn_ref(conn);
-    }
-    // auth requested by peer
-    if (bt_conn_set_security(conn, BT_SECURITY_L2)) {
-      printk("Failed to set security\n");
+  // show connection source mac address
+  bt_addr_le_to_str(bt_conn_get_dst(evt->conn), addr, sizeof(addr));
+  app_state_set_last_peer(bt_conn_get_dst(evt->conn));
+  LOG_INF("Connected %s (%ld centrals)", addr, atomic_get(&conn_count));
+
+  // auth requested by peer
+  if (bt_conn_set_security(evt->conn, BT_SECURITY_L2)) {
+    LOG_WRN("Failed to set security");
+  }
+}
+
+static void connected(struct bt_conn* conn, uint8_t err) {
+  uint32_t start = k_cycle_get_32();
+  const struct app_work_event evt = {
+      .type = APP_WORK_CONNECTED, .conn = conn, .err = err};
+
+  if (!err) {
+    atomic_inc(&conn_count);
+    if (!atomic_test_and_set_bit(&device_status_ptr->status_bits, CONNECTED)) {
+      post_status_event(STATUS_EVT_CONN);
     }
   }
+
+  app_work_submit(on_connected, &evt);
+  app_work_cb_timing("connected", start);
+}
+
+static void on_disconnected(const struct app_work_event* evt) {
+  LOG_INF("Disconnected (reason 0x%02x)", evt->reason);
 }
 
 static void disconnected(struct bt_conn* conn, uint8_t reason) {
-  printk("Disconnected (reason 0x%02x)\n", reason);
+  uint32_t start = k_cycle_get_32();
+  const struct app_work_event evt = {
+      .type = APP_WORK_DISCONNECTED, .reason = reason};
+
   // dk_set_led_off(CENTRAL_CON_STATUS_LED);
-  if (ble_conn) {
-    bt_conn_unref(ble_conn);
-    ble_conn = NULL;
+
+  // CONNECTED stays set while any other central is still connected
+  if (atomic_dec(&conn_count) == 1) {
+    atomic_clear_bit(&device_status_ptr->status_bits, CONNECTED);
+    post_status_event(STATUS_EVT_CONN);
   }
-  atomic_clear_bit(&device_status_ptr->status_bits, CONNECTED);
+
+  app_work_submit(on_disconnected, &evt);
+  app_work_cb_timing("disconnected", start);
 }
 
 static void alert_stop(void) {
-  printk("Alert stopped\n");
+  LOG_INF("Alert stopped");
 }
 
 static void alert_start(void) {
-  printk("Mild alert started\n");
+  LOG_INF("Mild alert started");
 }
 
 static void alert_high_start(void) {
-  printk("High alert started\n");
+  LOG_INF("High alert started");
 }
 
 BT_CONN_CB_DEFINE(conn_callbacks) = {
@@ -179,17 +141,46 @@ static void copy_last_bonded_addr(const struct bt_bond_info* info, void* data) {
   bt_addr_le_copy(&bond_addr, &info->addr);
 }
 
+// Settings nobody needs before advertising
+static void on_load_settings(const struct app_work_event* evt) {
+  int64_t start = k_uptime_get();
+
+  ARG_UNUSED(evt);
+
+  if (IS_ENABLED(CONFIG_APP_PEER_CACHE)) {
+    settings_load_subtree(PEER_CACHE_SUBTREE);
+  }
+  if (IS_ENABLED(CONFIG_APP_RECORD_STORE)) {
+    record_store_init();
+    bps_svc_records_loaded();
+  }
+
+  LOG_INF("Background settings load took %lld ms", k_uptime_get() - start);
+  load_gen_app_ready();
+}
+
 static void bt_ready(void) {
-  int err;
+  const struct app_work_event load_evt = {.type = APP_WORK_LOAD_SETTINGS};
+  struct app_state state;
+  int err = 0;
   bt_addr_le_t addr_le = {0};
   char addr[BT_ADDR_LE_STR_LEN];
   size_t count = 1;
 
-  printk("Bluetooth initialized\n");
+  LOG_INF("Bluetooth initialized");
 
-  // Load settings: includes bonded devices
+  // Only what the first advertisement depends on: identity, bonds and CCC
+  // state, and whether advertising was left on. The rest follows in the
+  // background, see on_load_settings().
   if (IS_ENABLED(CONFIG_SETTINGS)) {
-    settings_load();
+    settings_load_subtree("bt");
+    settings_load_subtree(APP_STATE_SUBTREE);
+  }
+  app_state_get(&state);
+
+  err = bps_svc_init();
+  if (err) {
+    LOG_ERR("BPS init failed (err %d)", err);
   }
 
   bt_addr_le_copy(&bond_addr, BT_ADDR_LE_NONE);
@@ -200,45 +191,63 @@ static void bt_ready(void) {
 	 */
   if (bt_addr_le_cmp(&bond_addr, BT_ADDR_LE_NONE) != 0) {
     bt_addr_le_to_str(&bond_addr, addr, sizeof(addr));
-    printk("Bonded by %s\n", addr);
+    LOG_INF("Bonded by %s", addr);
 
-    adv_param = *BT_LE_ADV_CONN_DIR_LOW_DUTY(&bond_addr);
-    adv_param.options |= BT_LE_ADV_OPT_DIR_ADDR_RPA;
-    // err = bt_le_adv_start(&adv_param, NULL, 0, NULL, 0);
     atomic_set_bit(&device_status_ptr->status_bits, IS_BONDED);
     atomic_set_bit(&device_status_ptr->status_bits, BONDED);
+  }
+
+  // Directed to the bonded central first, see advertising.c
+  if (state.adv_enabled) {
     atomic_set_bit(&device_status_ptr->status_bits, ADV_IS_ENABLED);
     atomic_set_bit(&device_status_ptr->status_bits, ADV_ENABLE);
-    err = bt_le_adv_start(BT_LE_ADV_CONN_NAME, ad, ARRAY_SIZE(ad), NULL, 0);
+    err = advertising_start();
   } else {
-    atomic_set_bit(&device_status_ptr->status_bits, ADV_IS_ENABLED);
-    atomic_set_bit(&device_status_ptr->status_bits, ADV_ENABLE);
-    err = bt_le_adv_start(BT_LE_ADV_CONN_NAME, ad, ARRAY_SIZE(ad), NULL, 0);
+    LOG_INF("Advertising left off before reboot");
   }
 
   // Get the Bluetooth device address
   bt_id_get(&addr_le, &count);
   bt_addr_le_to_str(&addr_le, addr, sizeof(addr));
-  printk("Bluetooth Device Address: %s\n", addr);
+  LOG_INF("Bluetooth Device Address: %s", addr);
   struct bt_le_oob oob;
   if (bt_le_oob_get_local(BT_ID_DEFAULT, &oob) == 0) {
     addr_le = oob.addr;
     bt_addr_le_to_str(&addr_le, addr, sizeof(addr));
-    printk("OOB advertising as %s\n", addr);
+    LOG_INF("OOB advertising as %s", addr);
   }
 
   if (err) {
-    printk("Advertising failed to start (err %d)\n", err);
+    LOG_ERR("Advertising failed to start (err %d)", err);
+  } else if (state.adv_enabled) {
+    LOG_INF("Advertising successfully started");
+  }
+
+  post_status_event(STATUS_EVT_ADV | STATUS_EVT_BOND);
+
+  if (IS_ENABLED(CONFIG_SETTINGS)) {
+    app_work_submit(on_load_settings, &load_evt);
   } else {
-    printk("Advertising successfully started\n");
+    load_gen_app_ready();
   }
 }
 
+static void on_pairing_complete(const struct app_work_event* evt) {
+  LOG_INF("Pairing complete%s", evt->bonded ? ", bonded" : "");
+}
+
 void pairing_complete(struct bt_conn* conn, bool bonded) {
-  printk("Pairing complete\n");
+  uint32_t start = k_cycle_get_32();
+  const struct app_work_event evt = {
+      .type = APP_WORK_PAIRING_COMPLETE, .bonded = bonded};
+
   atomic_set_bit(&device_status_ptr->status_bits, IS_BONDED);
   atomic_set_bit(&device_status_ptr->status_bits, BONDED);
   bt_addr_le_copy(&bond_addr, bt_conn_get_dst(conn));
+  post_status_event(STATUS_EVT_BOND);
+
+  app_work_submit(on_pairing_complete, &evt);
+  app_work_cb_timing("pairing_complete", start);
 
   // printk("Pairing completed. Rebooting in 3 seconds...\n");
   // k_sleep(K_SECONDS(3));
@@ -248,28 +257,70 @@ void pairing_complete(struct bt_conn* conn, bool bonded) {
 static struct bt_conn_auth_info_cb bt_conn_auth_info = {.pairing_complete =
                                                             pairing_complete};
 
+static uint32_t dispatch_wakeups;
+
+static void dispatch_adv(void) {
+  int err = 0;
+
+  if (atomic_test_bit(&device_status_ptr->status_bits, ADV_ENABLE) &&
+      !atomic_test_bit(&device_status_ptr->status_bits, ADV_IS_ENABLED)) {
+    LOG_INF("Starting advertising");
+    atomic_set_bit(&device_status_ptr->status_bits, ADV_IS_ENABLED);
+    app_state_set_adv_enabled(true);
+    err = advertising_start();
+    trace_stage(TRACE_ADV_APPLIED);
+    LOG_DBG("Click to advertising %u us",
+            k_cyc_to_us_floor32(k_cycle_get_32() - status_event_posted_at()));
+  } else if (!atomic_test_bit(&device_status_ptr->status_bits, ADV_ENABLE) &&
+             atomic_test_bit(&device_status_ptr->status_bits,
+                             ADV_IS_ENABLED)) {
+    LOG_INF("Stopping advertising");
+    atomic_clear_bit(&device_status_ptr->status_bits, ADV_IS_ENABLED);
+    app_state_set_adv_enabled(false);
+    err = advertising_stop();
+    trace_stage(TRACE_ADV_APPLIED);
+  }
+
+  if (err) {
+    LOG_ERR("Advertising update failed (err %d)", err);
+  }
+}
+
+static void dispatch_bond(void) {
+  if (atomic_test_bit(&device_status_ptr->status_bits, BONDED) &&
+      !atomic_test_bit(&device_status_ptr->status_bits, IS_BONDED)) {
+    LOG_INF("Set bonding to true");
+    atomic_set_bit(&device_status_ptr->status_bits, IS_BONDED);
+  } else if (!atomic_test_bit(&device_status_ptr->status_bits, BONDED) &&
+             atomic_test_bit(&device_status_ptr->status_bits, IS_BONDED)) {
+    LOG_INF("Set bonding to false and call unpair");
+    atomic_clear_bit(&device_status_ptr->status_bits, IS_BONDED);
+    bt_unpair(BT_ID_DEFAULT, BT_ADDR_LE_ANY);
+  }
+}
+
 int main(void) {
-  struct bt_gatt_attr* vnd_ind_attr;
-  char str[BT_UUID_STR_LEN];
   int err;
 
   if ((device_status_ptr = get_status()) == NULL) {
     if (device_status_ptr == NULL) {
-      printk("device_status_ptr is NULL \n");
+      LOG_ERR("device_status_ptr is NULL");
     }
-    printk("Failed to get status bits\n");
+    LOG_ERR("Failed to get status bits");
     return 0;
   }
 
   if (app_event_manager_init()) {
-    printk("Application Event Manager not initialized\n");
+    LOG_ERR("Application Event Manager not initialized");
   } else {
     module_set_state(MODULE_STATE_READY);
   }
 
+  app_work_init();
+
   err = bt_enable(NULL);
   if (err) {
-    printk("Bluetooth init failed (err %d - %s)\n", err, strerror(-err));
+    LOG_ERR("Bluetooth init failed (err %d - %s)", err, strerror(-err));
     return 0;
   }
 
@@ -279,38 +330,27 @@ int main(void) {
 
   bt_gatt_cb_register(&gatt_callbacks);
 
-  vnd_ind_attr =
-      bt_gatt_find_by_uuid(bps_svc.attrs, bps_svc.attr_count, &bpm_uuid.uuid);
-  bt_uuid_to_str(&bpm_uuid.uuid, str, sizeof(str));
-  printk("Indicate BPS attr %p (UUID %s)\n", vnd_ind_attr, str);
+  conn_tuning_init();
 
   while (1) {
-    k_sleep(K_MSEC(10));
-
-    if (atomic_test_bit(&device_status_ptr->status_bits, ADV_ENABLE) &&
-        !atomic_test_bit(&device_status_ptr->status_bits, ADV_IS_ENABLED)) {
-      LOG_INF("Starting advertising");
-      atomic_set_bit(&device_status_ptr->status_bits, ADV_IS_ENABLED);
-      err = bt_le_adv_start(BT_LE_ADV_CONN_NAME, ad, ARRAY_SIZE(ad), NULL, 0);
-    } else if (!atomic_test_bit(&device_status_ptr->status_bits, ADV_ENABLE) &&
-               atomic_test_bit(&device_status_ptr->status_bits,
-                               ADV_IS_ENABLED)) {
-
-      LOG_INF("Stopping advertising");
-      atomic_clear_bit(&device_status_ptr->status_bits, ADV_IS_ENABLED);
-      err = bt_le_adv_stop();
+    // Sleep until a click or a BT callback actually changes something
+    uint32_t events = wait_status_event(
+        STATUS_EVT_ADV | STATUS_EVT_BOND | STATUS_EVT_RESET, K_FOREVER);
+
+    trace_stage(TRACE_DISPATCH);
+    dispatch_wakeups++;
+    LOG_DBG("Dispatch 0x%02x, %u wakeups in %lld ms", events, dispatch_wakeups,
+            k_uptime_get());
+
+    if (events & STATUS_EVT_ADV) {
+      dispatch_adv();
+    }
+    if (events & STATUS_EVT_BOND) {
+      dispatch_bond();
     }
-    {
-      if (atomic_test_bit(&device_status_ptr->status_bits, BONDED) &&
-          !atomic_test_bit(&device_status_ptr->status_bits, IS_BONDED)) {
-        LOG_INF("Set bonding to true");
-        atomic_set_bit(&device_status_ptr->status_bits, IS_BONDED);
-      } else if (!atomic_test_bit(&device_status_ptr->status_bits, BONDED) &&
-                 atomic_test_bit(&device_status_ptr->status_bits, IS_BONDED)) {
-        LOG_INF("Set bonding to false and call unpair");
-        atomic_clear_bit(&device_status_ptr->status_bits, IS_BONDED);
-        err = bt_unpair(BT_ID_DEFAULT, BT_ADDR_LE_ANY);
-      }
+    // Advertising off from the reset must not wait out the quiet period
+    if (events & STATUS_EVT_RESET) {
+      app_state_flush();
     }
   }
 
@@ -0,0 +1,217 @@
+#include <zephyr/kernel.h>
+
+#define MODULE battery
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_BATTERY_LOG_LEVEL);
+
+#include "modules/battery.h"
+
+#include <stdlib.h>
+#include <zephyr/bluetooth/services/bas.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/init.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/util.h>
+
+#include "battery_def.h"
+#include "log_ratelimit.h"
+
+#define BURST CONFIG_APP_BATTERY_BURST_SAMPLES
+#define FILTER_SHIFT CONFIG_APP_BATTERY_FILTER_SHIFT
+// Fraction bits of the filtered voltage
+#define FILTER_Q 4
+
+BUILD_ASSERT(DT_NODE_HAS_PROP(DT_PATH(zephyr_user), io_channels),
+             "The supply ADC channel is io-channels of /zephyr,user");
+
+static const struct adc_dt_spec supply = ADC_DT_SPEC_GET(DT_PATH(zephyr_user));
+
+// One burst, filled by a single ADC sequence
+static int16_t burst_buf[BURST];
+
+// Exponential moving average in mV << FILTER_Q, 0 before the first burst
+static int32_t filtered_q;
+static uint8_t level;
+// Last level given to the Battery Service, -1 before the first
+static int reported = -1;
+
+static struct {
+  atomic_t bursts;
+  atomic_t samples;
+  atomic_t updates;
+  atomic_t errors;
+  int64_t since_ms;
+} stats;
+
+static void sample_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(sample_work, sample_work_fn);
+
+static uint8_t mv_to_level(int32_t mv) {
+  if (mv >= battery_curve[0].mv) {
+    return battery_curve[0].level;
+  }
+
+  for (size_t i = 1; i < ARRAY_SIZE(battery_curve); i++) {
+    const struct battery_level_point* hi = &battery_curve[i - 1];
+    const struct battery_level_point* lo = &battery_curve[i];
+
+    if (mv >= lo->mv) {
+      return lo->level +
+             (mv - lo->mv) * (hi->level - lo->level) / (hi->mv - lo->mv);
+    }
+  }
+
+  return battery_curve[ARRAY_SIZE(battery_curve) - 1].level;
+}
+
+// All conversions of the burst in one adc_read(): the sequence is set up
+// once and the thread only wakes up for the result. The nRF SAADC driver
+// still takes an interrupt per sample, adc_context starts each further
+// sampling from the END event.
+static int read_burst(int32_t* mv) {
+  struct adc_sequence_options options = {
+      .extra_samplings = BURST - 1,
+  };
+  struct adc_sequence seq = {
+      .options = &options,
+      .buffer = burst_buf,
+      .buffer_size = sizeof(burst_buf),
+  };
+  int32_t sum = 0;
+  int err;
+
+  err = adc_sequence_init_dt(&supply, &seq);
+  if (err) {
+    return err;
+  }
+  err = adc_read(supply.dev, &seq);
+  if (err) {
+    return err;
+  }
+
+  for (size_t i = 0; i < BURST; i++) {
+    sum += burst_buf[i];
+  }
+  *mv = sum / BURST;
+  return adc_raw_to_millivolts_dt(&supply, mv);
+}
+
+static void update(int32_t mv) {
+  int32_t filtered_mv;
+
+  if (filtered_q == 0) {
+    filtered_q = mv << FILTER_Q;
+  } else {
+    filtered_q += ((mv << FILTER_Q) - filtered_q) / (1 << FILTER_SHIFT);
+  }
+  filtered_mv = (filtered_q + BIT(FILTER_Q - 1)) >> FILTER_Q;
+  level = mv_to_level(filtered_mv);
+
+  if (level == reported) {
+    return;
+  }
+  // Full and empty always go out, so the last step is never swallowed
+  if (reported >= 0 && level != 0 && level != 100 &&
+      abs(level - reported) < CONFIG_APP_BATTERY_REPORT_STEP) {
+    return;
+  }
+
+  LOG_INF("Battery %u %% (%d mV)", level, filtered_mv);
+  reported = level;
+  atomic_inc(&stats.updates);
+  // Notifies subscribed centrals, the level is kept for reads either way
+  bt_bas_set_battery_level(level);
+}
+
+static void sample_work_fn(struct k_work* work) {
+  int32_t mv;
+  int err = read_burst(&mv);
+
+  if (err) {
+    atomic_inc(&stats.errors);
+    LOG_RATELIMIT(LOG_WRN, "Supply voltage not read (err %d)", err);
+  } else {
+    atomic_inc(&stats.bursts);
+    atomic_add(&stats.samples, BURST << supply.oversampling);
+    update(mv);
+  }
+
+  k_work_reschedule(&sample_work, K_SECONDS(CONFIG_APP_BATTERY_INTERVAL_S));
+}
+
+static int battery_init(void) {
+  int err;
+
+  if (!adc_is_ready_dt(&supply)) {
+    LOG_ERR("Supply ADC not ready");
+    return -ENODEV;
+  }
+
+  err = adc_channel_setup_dt(&supply);
+  if (err) {
+    LOG_ERR("Supply ADC channel setup failed (err %d)", err);
+    return err;
+  }
+
+  stats.since_ms = k_uptime_get();
+  // Right away, so the service never shows its default level
+  k_work_schedule(&sample_work, K_NO_WAIT);
+  return 0;
+}
+
+SYS_INIT(battery_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if IS_ENABLED(CONFIG_APP_BATTERY_SHELL)
+// Count per hour of uptime, in tenths
+static uint32_t per_hour_x10(atomic_t* count, int64_t elapsed_ms) {
+  return (uint64_t)atomic_get(count) * 36000000 / MAX(elapsed_ms, 1);
+}
+
+static int cmd_battery_show(const struct shell* sh, size_t argc,
+                            char** argv) {
+  int64_t elapsed_ms = k_uptime_get() - stats.since_ms;
+  uint32_t bursts = per_hour_x10(&stats.bursts, elapsed_ms);
+  uint32_t samples = per_hour_x10(&stats.samples, elapsed_ms);
+  uint32_t updates = per_hour_x10(&stats.updates, elapsed_ms);
+
+  shell_print(sh, "level %u %%, reported %d %%, filtered %d mV", level,
+              reported, (filtered_q + BIT(FILTER_Q - 1)) >> FILTER_Q);
+  shell_print(sh, "%ld bursts, %ld samples, %ld updates, %ld errors in %lld s",
+              atomic_get(&stats.bursts), atomic_get(&stats.samples),
+              atomic_get(&stats.updates), atomic_get(&stats.errors),
+              elapsed_ms / 1000);
+  shell_print(sh, "per hour: %u.%u bursts, %u.%u samples, %u.%u updates",
+              bursts / 10, bursts % 10, samples / 10, samples % 10,
+              updates / 10, updates % 10);
+  return 0;
+}
+
+static int cmd_battery_reset(const struct shell* sh, size_t argc,
+                             char** argv) {
+  atomic_clear(&stats.bursts);
+  atomic_clear(&stats.samples);
+  atomic_clear(&stats.updates);
+  atomic_clear(&stats.errors);
+  stats.since_ms = k_uptime_get();
+  shell_print(sh, "Battery statistics reset");
+  return 0;
+}
+
+static int cmd_battery_sample(const struct shell* sh, size_t argc,
+                              char** argv) {
+  k_work_reschedule(&sample_work, K_NO_WAIT);
+  shell_print(sh, "Sampling");
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    battery_cmds,
+    SHELL_CMD(show, NULL, "Level, filtered voltage and rates",
+              cmd_battery_show),
+    SHELL_CMD(reset, NULL, "Restart the rates from now", cmd_battery_reset),
+    SHELL_CMD(sample, NULL, "Take a burst now", cmd_battery_sample),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(battery, &battery_cmds, "Battery monitor", NULL);
+#endif
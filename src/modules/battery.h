@@ -0,0 +1,20 @@
+#ifndef ST_BLE_BATTERY_H_
+#define ST_BLE_BATTERY_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One point of a board's discharge curve, see battery_def.h
+struct battery_level_point {
+  uint16_t mv;
+  uint8_t level;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_BATTERY_H_ */
@@ -0,0 +1,102 @@
+#include <zephyr/kernel.h>
+
+#define MODULE battery_sim
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_BATTERY_SIM_LOG_LEVEL);
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+#include <zephyr/init.h>
+#include <zephyr/shell/shell.h>
+
+static const struct adc_dt_spec supply = ADC_DT_SPEC_GET(DT_PATH(zephyr_user));
+
+// Supply voltage over time: a straight line from start_mv to end_mv, then
+// flat, with uniform noise of up to noise_mv either way
+struct curve {
+  const char* name;
+  uint16_t start_mv;
+  uint16_t end_mv;
+  uint16_t noise_mv;
+};
+
+static const struct curve curves[] = {
+    {.name = "flat", .start_mv = 2900, .end_mv = 2900, .noise_mv = 15},
+    {.name = "discharge", .start_mv = 3000, .end_mv = 2300, .noise_mv = 0},
+    {.name = "noisy", .start_mv = 3000, .end_mv = 2300, .noise_mv = 40},
+};
+
+static const struct curve* active = &curves[0];
+static int64_t started_ms;
+static int64_t duration_ms = 24 * 3600 * 1000LL;
+static uint32_t noise_state = 1;
+
+// Called by the emulator for every conversion
+static int curve_value(const struct device* dev, unsigned int chan,
+                       void* data, uint32_t* result) {
+  int64_t elapsed = MIN(k_uptime_get() - started_ms, duration_ms);
+  int32_t mv = active->start_mv +
+               ((int32_t)active->end_mv - active->start_mv) * elapsed /
+                   duration_ms;
+
+  if (active->noise_mv) {
+    // xorshift32, repeatable between runs
+    noise_state ^= noise_state << 13;
+    noise_state ^= noise_state >> 17;
+    noise_state ^= noise_state << 5;
+    mv += (int32_t)(noise_state % (2 * active->noise_mv + 1)) -
+          active->noise_mv;
+  }
+
+  *result = MAX(mv, 0);
+  return 0;
+}
+
+static int cmd_curve(const struct shell* sh, size_t argc, char** argv) {
+  const struct curve* c = NULL;
+  int hours = argc > 2 ? atoi(argv[2]) : 24;
+
+  for (size_t i = 0; i < ARRAY_SIZE(curves); i++) {
+    if (!strcmp(argv[1], curves[i].name)) {
+      c = &curves[i];
+    }
+  }
+  if (c == NULL || hours <= 0) {
+    shell_error(sh,
+                "Usage: battery_sim curve <flat|discharge|noisy> [hours]");
+    return -EINVAL;
+  }
+
+  active = c;
+  duration_ms = hours * 3600 * 1000LL;
+  started_ms = k_uptime_get();
+  noise_state = 1;
+  shell_print(sh, "Curve %s, %u to %u mV over %d h", c->name, c->start_mv,
+              c->end_mv, hours);
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    battery_sim_cmds,
+    SHELL_CMD_ARG(curve, NULL, "<flat|discharge|noisy> [hours], from now",
+                  cmd_curve, 2, 1),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(battery_sim, &battery_sim_cmds, "Emulated supply voltage",
+                   NULL);
+
+// Before the battery monitor takes its first burst
+static int battery_sim_init(void) {
+  int err = adc_emul_value_func_set(supply.dev, supply.channel_id,
+                                    curve_value, NULL);
+
+  if (err) {
+    LOG_ERR("Cannot drive the ADC emulator (err %d)", err);
+  }
+  return err;
+}
+
+SYS_INIT(battery_sim_init, APPLICATION, 0);
@@ -0,0 +1,201 @@
+#include <zephyr/kernel.h>
+
+#define MODULE button_irq
+#include <caf/events/button_event.h>
+#include <caf/events/click_event.h>
+#include <caf/events/module_state_event.h>
+#include <caf/key_id.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_BUTTON_IRQ_LOG_LEVEL);
+
+#include "button_svc.h"
+#include "modules/trace.h"
+
+// The single button of the board, same id as in click_detector_def.h
+#define BUTTON_KEY_ID KEY_ID(0x00, 0x00)
+
+#define DEBOUNCE K_MSEC(CONFIG_APP_BUTTON_IRQ_DEBOUNCE_MS)
+#define LONG_CLICK K_MSEC(CONFIG_APP_BUTTON_IRQ_LONG_CLICK_MS)
+#define DOUBLE_CLICK K_MSEC(CONFIG_APP_BUTTON_IRQ_DOUBLE_CLICK_MS)
+
+enum click_state {
+  // Released, nothing pending: no timer runs
+  STATE_IDLE,
+  // First press, long click when the click timer expires
+  STATE_PRESSED,
+  // Long click reported, waiting for the release
+  STATE_HELD,
+  // Short click reported, a press before the click timer makes it double
+  STATE_RELEASED,
+  // Second press, double click on release
+  STATE_PRESSED_AGAIN,
+};
+
+// Everything runs in the GPIO ISR and the timer handlers
+static struct k_spinlock lock;
+static enum click_state state;
+// Debounced level
+static bool pressed;
+
+static void debounce_fn(struct k_timer* timer);
+static void click_fn(struct k_timer* timer);
+static K_TIMER_DEFINE(debounce_timer, debounce_fn, NULL);
+static K_TIMER_DEFINE(click_timer, click_fn, NULL);
+
+// Event submission is ISR safe, the handlers run on the event manager's
+// queue as with the CAF click detector
+static void send_click(enum click click) {
+  struct click_event* event = new_click_event();
+
+  event->key_id = BUTTON_KEY_ID;
+  event->click = click;
+  APP_EVENT_SUBMIT(event);
+}
+
+static void send_button(bool is_pressed) {
+  struct button_event* event = new_button_event();
+
+  event->key_id = BUTTON_KEY_ID;
+  event->pressed = is_pressed;
+  APP_EVENT_SUBMIT(event);
+}
+
+static void on_change(bool is_pressed) {
+  switch (state) {
+    case STATE_IDLE:
+      if (is_pressed) {
+        state = STATE_PRESSED;
+        k_timer_start(&click_timer, LONG_CLICK, K_NO_WAIT);
+      }
+      break;
+    case STATE_PRESSED:
+      if (!is_pressed) {
+        send_click(CLICK_SHORT);
+        state = STATE_RELEASED;
+        k_timer_start(&click_timer, DOUBLE_CLICK, K_NO_WAIT);
+      }
+      break;
+    case STATE_HELD:
+      if (!is_pressed) {
+        state = STATE_IDLE;
+      }
+      break;
+    case STATE_RELEASED:
+      if (is_pressed) {
+        state = STATE_PRESSED_AGAIN;
+        k_timer_start(&click_timer, LONG_CLICK, K_NO_WAIT);
+      }
+      break;
+    case STATE_PRESSED_AGAIN:
+      if (!is_pressed) {
+        k_timer_stop(&click_timer);
+        send_click(CLICK_DOUBLE);
+        state = STATE_IDLE;
+      }
+      break;
+  }
+}
+
+static void click_fn(struct k_timer* timer) {
+  k_spinlock_key_t key = k_spin_lock(&lock);
+
+  switch (state) {
+    case STATE_PRESSED:
+    case STATE_PRESSED_AGAIN:
+      send_click(CLICK_LONG);
+      state = STATE_HELD;
+      break;
+    case STATE_RELEASED:
+      state = STATE_IDLE;
+      break;
+    default:
+      break;
+  }
+  k_spin_unlock(&lock, key);
+}
+
+// Interrupt on the edge away from the debounced level. A change while
+// arming would be lost, so check the level once more afterwards.
+static void arm(void) {
+  int err = button_interrupt_configure(pressed ? GPIO_INT_EDGE_TO_INACTIVE
+                                               : GPIO_INT_EDGE_TO_ACTIVE);
+  int level;
+
+  if (err) {
+    LOG_ERR("Cannot arm the button interrupt (err %d)", err);
+    return;
+  }
+  level = button_get();
+  if (level >= 0 && level != pressed) {
+    button_interrupt_configure(GPIO_INT_DISABLE);
+    k_timer_start(&debounce_timer, DEBOUNCE, K_NO_WAIT);
+  }
+}
+
+static void debounce_fn(struct k_timer* timer) {
+  k_spinlock_key_t key = k_spin_lock(&lock);
+  int level = button_get();
+
+  if (level >= 0 && level != pressed) {
+    pressed = level;
+    send_button(pressed);
+    on_change(pressed);
+  }
+  arm();
+  k_spin_unlock(&lock, key);
+}
+
+static void on_edge(const struct device* port, struct gpio_callback* cb,
+                    uint32_t pins) {
+  k_spinlock_key_t key = k_spin_lock(&lock);
+
+  // Mute the pin until it settles, bounces would only restart the timer
+  button_interrupt_configure(GPIO_INT_DISABLE);
+  if (state == STATE_IDLE && !pressed) {
+    trace_begin(TRACE_PATH_BUTTON);
+  }
+  k_timer_start(&debounce_timer, DEBOUNCE, K_NO_WAIT);
+  k_spin_unlock(&lock, key);
+}
+
+static int button_irq_start(void) {
+  k_spinlock_key_t key;
+  int err = button_init(on_edge);
+
+  if (err) {
+    return err;
+  }
+
+  // button_init() armed for a press, which is right unless already held
+  key = k_spin_lock(&lock);
+  arm();
+  k_spin_unlock(&lock, key);
+  return 0;
+}
+
+static bool app_event_handler(const struct app_event_header* aeh) {
+  if (is_module_state_event(aeh)) {
+    const struct module_state_event* event = cast_module_state_event(aeh);
+
+    if (check_state(event, MODULE_ID(main), MODULE_STATE_READY)) {
+      int err = button_irq_start();
+
+      if (err) {
+        LOG_ERR("Button backend not started (err %d)", err);
+        module_set_state(MODULE_STATE_ERROR);
+      } else {
+        module_set_state(MODULE_STATE_READY);
+      }
+    }
+    return false;
+  }
+
+  /* Event not handled but subscribed. */
+  __ASSERT_NO_MSG(false);
+
+  return false;
+}
+
+APP_EVENT_LISTENER(MODULE, app_event_handler);
+APP_EVENT_SUBSCRIBE(MODULE, module_state_event);
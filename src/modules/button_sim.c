@@ -0,0 +1,78 @@
+#include <zephyr/kernel.h>
+
+#define MODULE button_sim
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_BUTTON_SIM_LOG_LEVEL);
+
+#include <stdlib.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/init.h>
+#include <zephyr/shell/shell.h>
+
+#include "modules/trace.h"
+
+static const struct gpio_dt_spec button =
+    GPIO_DT_SPEC_GET(DT_ALIAS(sw0), gpios);
+
+// Gap between the presses of a double click
+#define CLICK_GAP_MS 100
+
+static void set_pressed(bool pressed) {
+  bool active_low = button.dt_flags & GPIO_ACTIVE_LOW;
+
+  gpio_emul_input_set(button.port, button.pin, pressed != active_low);
+}
+
+static int cmd_button_click(const struct shell* sh, size_t argc, char** argv) {
+  int hold_ms = atoi(argv[1]);
+  int count = argc > 2 ? atoi(argv[2]) : 1;
+
+  if (hold_ms <= 0 || count < 1 || count > 2) {
+    shell_error(sh, "Usage: button click <hold_ms> [1|2]");
+    return -EINVAL;
+  }
+
+  // The button path starts at the edge, whichever backend picks it up
+  trace_begin(TRACE_PATH_BUTTON);
+  for (int i = 0; i < count; i++) {
+    if (i > 0) {
+      k_msleep(CLICK_GAP_MS);
+    }
+    set_pressed(true);
+    k_msleep(hold_ms);
+    set_pressed(false);
+  }
+
+  shell_print(sh, "Clicked %d x %d ms", count, hold_ms);
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    button_cmds,
+    SHELL_CMD_ARG(click, NULL, "Press <hold_ms>, twice for a double click",
+                  cmd_button_click, 2, 1),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(button, &button_cmds, "Emulated button", NULL);
+
+// The emulator starts every input low, which is pressed for an active low
+// button: release it before the button backends look at it
+static int button_sim_init(void) {
+  int err;
+
+  if (!gpio_is_ready_dt(&button)) {
+    return -ENODEV;
+  }
+  // The emulator only takes input levels for pins configured as inputs
+  err = gpio_pin_configure_dt(&button, GPIO_INPUT);
+  if (err) {
+    LOG_ERR("Cannot configure the button (err %d)", err);
+    return err;
+  }
+  set_pressed(false);
+  return 0;
+}
+
+SYS_INIT(button_sim_init, APPLICATION, 0);
@@ -3,6 +3,7 @@
 #define ST_BLE_BUTTON_STATE_H_
 
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/kernel.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,9 +30,30 @@ struct device_status {
   atomic_t status_bits;
 };
 
+// Change notifications posted alongside the status bits above
+enum status_event_enum {
+  // ADV_ENABLE changed
+  STATUS_EVT_ADV = BIT(0),
+  // BONDED or IS_BONDED changed
+  STATUS_EVT_BOND = BIT(1),
+  // CONNECTED changed
+  STATUS_EVT_CONN = BIT(2),
+  // RESET requested
+  STATUS_EVT_RESET = BIT(3),
+};
+
 // Singleton instance of device status, used to control LED and receive button events
 struct device_status* get_status(void);
 
+// Wake up the status dispatcher, callable from any context (ISR included)
+void post_status_event(uint32_t events);
+
+// Block until one of the events in mask is posted, returns and clears them
+uint32_t wait_status_event(uint32_t mask, k_timeout_t timeout);
+
+// Cycle counter value of the most recent post_status_event() call
+uint32_t status_event_posted_at(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,257 @@
+#include <zephyr/kernel.h>
+
+#define MODULE conn_params
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_CONN_PARAMS_LOG_LEVEL);
+
+#include "modules/conn_params.h"
+#include "modules/peer_cache.h"
+
+#include <string.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/shell/shell.h>
+
+enum conn_mode {
+  CONN_MODE_NONE,
+  CONN_MODE_FAST,
+  CONN_MODE_IDLE,
+};
+
+static const struct bt_le_conn_param fast_param = {
+    .interval_min = CONFIG_APP_CONN_PARAMS_FAST_INTERVAL_MIN,
+    .interval_max = CONFIG_APP_CONN_PARAMS_FAST_INTERVAL_MAX,
+    .latency = 0,
+    .timeout = CONFIG_APP_CONN_PARAMS_TIMEOUT,
+};
+
+static const struct bt_le_conn_param idle_param = {
+    .interval_min = CONFIG_APP_CONN_PARAMS_IDLE_INTERVAL_MIN,
+    .interval_max = CONFIG_APP_CONN_PARAMS_IDLE_INTERVAL_MAX,
+    .latency = CONFIG_APP_CONN_PARAMS_IDLE_LATENCY,
+    .timeout = CONFIG_APP_CONN_PARAMS_TIMEOUT,
+};
+
+BUILD_ASSERT(CONFIG_APP_CONN_PARAMS_TIMEOUT * 10 * 1000 >
+                 (1 + CONFIG_APP_CONN_PARAMS_IDLE_LATENCY) *
+                     CONFIG_APP_CONN_PARAMS_IDLE_INTERVAL_MAX * 1250 * 2,
+             "Supervision timeout too short for the idle latency");
+
+static struct mode_ctx {
+  // Mode of the interval currently in use and since when, under stats_lock
+  enum conn_mode mode;
+  int64_t since;
+  // Mode last requested from the central
+  enum conn_mode requested;
+} ctx[CONFIG_BT_MAX_CONN];
+
+static atomic_t busy;
+static K_MUTEX_DEFINE(stats_lock);
+static struct conn_params_stats stats;
+
+// Caller holds stats_lock
+static void account_mode(const struct mode_ctx* c, int64_t now,
+                         struct conn_params_stats* out) {
+  if (c->mode == CONN_MODE_FAST) {
+    out->fast_ms += now - c->since;
+  } else if (c->mode == CONN_MODE_IDLE) {
+    out->idle_ms += now - c->since;
+  }
+}
+
+static void update_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(update_work, update_work_fn);
+
+static enum conn_mode mode_of(uint16_t interval) {
+  return (interval <= CONFIG_APP_CONN_PARAMS_FAST_INTERVAL_MAX)
+             ? CONN_MODE_FAST
+             : CONN_MODE_IDLE;
+}
+
+// Account the time spent in the previous mode and switch to the new one
+static void enter_mode(struct mode_ctx* c, enum conn_mode mode) {
+  int64_t now = k_uptime_get();
+
+  k_mutex_lock(&stats_lock, K_FOREVER);
+  account_mode(c, now, &stats);
+  c->mode = mode;
+  c->since = now;
+  k_mutex_unlock(&stats_lock);
+}
+
+static void request_mode(struct bt_conn* conn, void* data) {
+  struct mode_ctx* c = &ctx[bt_conn_index(conn)];
+  enum conn_mode mode = *(enum conn_mode*)data;
+  int err;
+
+  if (c->requested == mode) {
+    return;
+  }
+
+  err = bt_conn_le_param_update(
+      conn, (mode == CONN_MODE_FAST) ? &fast_param : &idle_param);
+
+  k_mutex_lock(&stats_lock, K_FOREVER);
+  if (err) {
+    stats.failed++;
+  } else {
+    stats.requested++;
+  }
+  k_mutex_unlock(&stats_lock);
+
+  if (err) {
+    LOG_WRN("Parameter update failed (err %d)", err);
+    return;
+  }
+
+  c->requested = mode;
+  LOG_DBG("Requested %s interval", (mode == CONN_MODE_FAST) ? "fast" : "idle");
+}
+
+static void update_work_fn(struct k_work* work) {
+  enum conn_mode mode = atomic_get(&busy) ? CONN_MODE_FAST : CONN_MODE_IDLE;
+
+  ARG_UNUSED(work);
+  bt_conn_foreach(BT_CONN_TYPE_LE, request_mode, &mode);
+}
+
+void conn_params_busy(bool is_busy) {
+  if (is_busy) {
+    if (!atomic_set(&busy, 1)) {
+      k_work_reschedule(&update_work, K_NO_WAIT);
+    }
+  } else if (atomic_set(&busy, 0)) {
+    // Hysteresis: only relax once nothing was queued for a while
+    k_work_reschedule(&update_work,
+                      K_MSEC(CONFIG_APP_CONN_PARAMS_IDLE_DELAY_MS));
+  }
+}
+
+void conn_params_get_stats(struct conn_params_stats* out) {
+  int64_t now = k_uptime_get();
+
+  k_mutex_lock(&stats_lock, K_FOREVER);
+  *out = stats;
+  for (size_t i = 0; i < ARRAY_SIZE(ctx); i++) {
+    account_mode(&ctx[i], now, out);
+  }
+  k_mutex_unlock(&stats_lock);
+}
+
+void conn_params_reset_stats(void) {
+  int64_t now = k_uptime_get();
+
+  k_mutex_lock(&stats_lock, K_FOREVER);
+  memset(&stats, 0, sizeof(stats));
+  for (size_t i = 0; i < ARRAY_SIZE(ctx); i++) {
+    ctx[i].since = now;
+  }
+  k_mutex_unlock(&stats_lock);
+}
+
+static void connected(struct bt_conn* conn, uint8_t err) {
+  struct mode_ctx* c = &ctx[bt_conn_index(conn)];
+  struct peer_cache_entry cached;
+  struct bt_conn_info info;
+
+  if (err || bt_conn_get_info(conn, &info)) {
+    return;
+  }
+
+  c->mode = CONN_MODE_NONE;
+  c->requested = CONN_MODE_NONE;
+  enter_mode(c, mode_of(info.le.interval));
+
+  // Known central: go straight back to the parameters it ended with
+  if (peer_cache_get(info.le.dst, &cached) == 0 && cached.interval &&
+      cached.interval != info.le.interval) {
+    const struct bt_le_conn_param param = {
+        .interval_min = cached.interval,
+        .interval_max = cached.interval,
+        .latency = cached.latency,
+        .timeout = cached.timeout,
+    };
+
+    if (bt_conn_le_param_update(conn, &param) == 0) {
+      c->requested = mode_of(cached.interval);
+      k_mutex_lock(&stats_lock, K_FOREVER);
+      stats.requested++;
+      k_mutex_unlock(&stats_lock);
+      return;
+    }
+  }
+
+  // Leave the central's interval for discovery and pairing, then settle
+  k_work_reschedule(&update_work, K_MSEC(CONFIG_APP_CONN_PARAMS_IDLE_DELAY_MS));
+}
+
+static void disconnected(struct bt_conn* conn, uint8_t reason) {
+  struct mode_ctx* c = &ctx[bt_conn_index(conn)];
+  struct conn_params_stats s;
+
+  ARG_UNUSED(reason);
+
+  enter_mode(c, CONN_MODE_NONE);
+  conn_params_get_stats(&s);
+  LOG_INF("Fast %llu ms, idle %llu ms, %u/%u updates accepted", s.fast_ms,
+          s.idle_ms, s.accepted, s.requested);
+}
+
+static void param_updated(struct bt_conn* conn, uint16_t interval,
+                          uint16_t latency, uint16_t timeout) {
+  struct mode_ctx* c = &ctx[bt_conn_index(conn)];
+  const struct bt_le_conn_param* param =
+      (c->requested == CONN_MODE_FAST) ? &fast_param : &idle_param;
+
+  LOG_DBG("Interval %u, latency %u, timeout %u", interval, latency, timeout);
+
+  if (c->requested != CONN_MODE_NONE && interval >= param->interval_min &&
+      interval <= param->interval_max) {
+    k_mutex_lock(&stats_lock, K_FOREVER);
+    stats.accepted++;
+    k_mutex_unlock(&stats_lock);
+  }
+
+  enter_mode(c, mode_of(interval));
+}
+
+BT_CONN_CB_DEFINE(params_conn_callbacks) = {
+    .connected = connected,
+    .disconnected = disconnected,
+    .le_param_updated = param_updated,
+};
+
+#if IS_ENABLED(CONFIG_APP_CONN_PARAMS_SHELL)
+static int cmd_conn_params_show(const struct shell* sh, size_t argc,
+                                char** argv) {
+  struct conn_params_stats s;
+  uint64_t total;
+
+  conn_params_get_stats(&s);
+  total = MAX(s.fast_ms + s.idle_ms, 1);
+
+  shell_print(sh, "%u requested, %u accepted, %u failed", s.requested,
+              s.accepted, s.failed);
+  shell_print(sh, "fast %llu ms (%llu%%), idle %llu ms (%llu%%)", s.fast_ms,
+              s.fast_ms * 100 / total, s.idle_ms, s.idle_ms * 100 / total);
+  return 0;
+}
+
+static int cmd_conn_params_reset(const struct shell* sh, size_t argc,
+                                 char** argv) {
+  conn_params_reset_stats();
+  shell_print(sh, "Connection parameter statistics reset");
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    conn_params_cmds,
+    SHELL_CMD(show, NULL, "Update requests and time per interval mode",
+              cmd_conn_params_show),
+    SHELL_CMD(reset, NULL, "Start counting from now", cmd_conn_params_reset),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(conn_params, &conn_params_cmds,
+                   "Connection parameter manager", NULL);
+#endif
@@ -0,0 +1,43 @@
+#ifndef ST_BLE_CONN_PARAMS_H_
+#define ST_BLE_CONN_PARAMS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct conn_params_stats {
+  // Parameter update requests sent to centrals
+  uint32_t requested;
+  // Updates applied with the requested interval range
+  uint32_t accepted;
+  // Requests the host could not send
+  uint32_t failed;
+  // Connected time spent with a fast / idle interval
+  uint64_t fast_ms;
+  uint64_t idle_ms;
+};
+
+#if IS_ENABLED(CONFIG_APP_CONN_PARAMS)
+// Report whether data is waiting to be sent. Going busy switches to the fast
+// interval at once, going idle switches back after a quiet period.
+// Callable from any context.
+void conn_params_busy(bool busy);
+
+// Totals since boot or the last conn_params_reset_stats(), the time in the
+// current mode of each connection included
+void conn_params_get_stats(struct conn_params_stats* stats);
+void conn_params_reset_stats(void);
+#else
+static inline void conn_params_busy(bool busy) {}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_CONN_PARAMS_H_ */
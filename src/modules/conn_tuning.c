@@ -0,0 +1,197 @@
+#include <zephyr/kernel.h>
+
+#define MODULE conn_tuning
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_CONN_TUNING_LOG_LEVEL);
+
+#include "modules/conn_tuning.h"
+#include "modules/peer_cache.h"
+
+#include <string.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/util.h>
+
+// Link defaults before any procedure completes
+#define DEFAULT_MTU 23
+#define DEFAULT_TX_OCTETS 27
+
+// L2CAP and ATT notification headers in front of the attribute value
+#define NOTIFY_HDR_LEN (4 + 3)
+// Preamble, access address, LL header, MIC and CRC around each LL payload
+#define PDU_OVERHEAD_LEN 14
+#define EMPTY_PDU_LEN 10
+#define T_IFS_US 150
+
+static struct tuning_ctx {
+  struct conn_tuning_info info;
+  struct bt_gatt_exchange_params mtu_params;
+  // Procedures still to be started
+  uint8_t pending;
+} ctx[CONFIG_BT_MAX_CONN];
+
+static void tune_work_fn(struct k_work* work);
+static K_WORK_DEFINE(tune_work, tune_work_fn);
+
+static inline struct tuning_ctx* ctx_get(struct bt_conn* conn) {
+  return &ctx[bt_conn_index(conn)];
+}
+
+static void mtu_exchanged(struct bt_conn* conn, uint8_t err,
+                          struct bt_gatt_exchange_params* params) {
+  struct tuning_ctx* c = ctx_get(conn);
+
+  ARG_UNUSED(params);
+
+  if (err) {
+    c->info.refused |= CONN_TUNING_MTU;
+    LOG_WRN("MTU exchange failed (err %u), staying at %u", err, c->info.mtu);
+    return;
+  }
+
+  c->info.mtu = bt_gatt_get_mtu(conn);
+  LOG_INF("MTU %u", c->info.mtu);
+}
+
+static void start_procedures(struct bt_conn* conn, void* data) {
+  struct tuning_ctx* c = ctx_get(conn);
+  struct bt_conn_info info;
+  int err;
+
+  ARG_UNUSED(data);
+
+  if (!c->pending || bt_conn_get_info(conn, &info) ||
+      info.state != BT_CONN_STATE_CONNECTED) {
+    return;
+  }
+
+  if (c->pending & CONN_TUNING_PHY) {
+    err = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+    if (err) {
+      c->info.refused |= CONN_TUNING_PHY;
+      LOG_WRN("PHY update failed (err %d)", err);
+    }
+  }
+
+  if (c->pending & CONN_TUNING_DLE) {
+    err = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+    if (err) {
+      c->info.refused |= CONN_TUNING_DLE;
+      LOG_WRN("Data length update failed (err %d)", err);
+    }
+  }
+
+  if (c->pending & CONN_TUNING_MTU) {
+    c->mtu_params.func = mtu_exchanged;
+    err = bt_gatt_exchange_mtu(conn, &c->mtu_params);
+    // -EALREADY: the central already ran the exchange
+    if (err && err != -EALREADY) {
+      c->info.refused |= CONN_TUNING_MTU;
+      LOG_WRN("MTU exchange failed (err %d)", err);
+    }
+  }
+
+  c->pending = 0;
+}
+
+static void tune_work_fn(struct k_work* work) {
+  ARG_UNUSED(work);
+  bt_conn_foreach(BT_CONN_TYPE_LE, start_procedures, NULL);
+}
+
+static void connected(struct bt_conn* conn, uint8_t err) {
+  struct peer_cache_entry cached;
+  struct tuning_ctx* c;
+
+  if (err) {
+    return;
+  }
+
+  c = ctx_get(conn);
+  memset(c, 0, sizeof(*c));
+  c->info.mtu = DEFAULT_MTU;
+  c->info.tx_octets = DEFAULT_TX_OCTETS;
+  c->info.tx_phy = BT_GAP_LE_PHY_1M;
+  c->pending = CONN_TUNING_MTU | CONN_TUNING_DLE | CONN_TUNING_PHY;
+
+  // Don't spend round trips on procedures this central refused last time
+  if (peer_cache_get(bt_conn_get_dst(conn), &cached) == 0) {
+    c->info.refused = cached.refused & (CONN_TUNING_DLE | CONN_TUNING_PHY);
+    c->pending &= ~c->info.refused;
+  }
+
+  k_work_submit(&tune_work);
+}
+
+static void phy_updated(struct bt_conn* conn,
+                        struct bt_conn_le_phy_info* param) {
+  struct tuning_ctx* c = ctx_get(conn);
+
+  c->info.tx_phy = param->tx_phy;
+  if (param->tx_phy != BT_GAP_LE_PHY_2M) {
+    c->info.refused |= CONN_TUNING_PHY;
+  }
+  LOG_INF("PHY TX %u RX %u", param->tx_phy, param->rx_phy);
+}
+
+static void data_len_updated(struct bt_conn* conn,
+                             struct bt_conn_le_data_len_info* info) {
+  struct tuning_ctx* c = ctx_get(conn);
+
+  c->info.tx_octets = info->tx_max_len;
+  if (info->tx_max_len <= DEFAULT_TX_OCTETS) {
+    c->info.refused |= CONN_TUNING_DLE;
+  }
+  LOG_INF("Data length TX %u B / %u us, RX %u B / %u us", info->tx_max_len,
+          info->tx_max_time, info->rx_max_len, info->rx_max_time);
+}
+
+BT_CONN_CB_DEFINE(tuning_conn_callbacks) = {
+    .connected = connected,
+    .le_phy_updated = phy_updated,
+    .le_data_len_updated = data_len_updated,
+};
+
+// MTU exchanges started by the central
+static void mtu_updated(struct bt_conn* conn, uint16_t tx, uint16_t rx) {
+  ctx_get(conn)->info.mtu = MIN(tx, rx);
+}
+
+static struct bt_gatt_cb tuning_gatt_callbacks = {.att_mtu_updated =
+                                                      mtu_updated};
+
+void conn_tuning_init(void) {
+  bt_gatt_cb_register(&tuning_gatt_callbacks);
+}
+
+void conn_tuning_get(struct bt_conn* conn, struct conn_tuning_info* info) {
+  *info = ctx_get(conn)->info;
+}
+
+uint8_t conn_tuning_tx_window(struct bt_conn* conn, uint16_t len,
+                              uint8_t max) {
+  const struct conn_tuning_info* info = &ctx_get(conn)->info;
+  struct bt_conn_info conn_info;
+  uint32_t rate = (info->tx_phy == BT_GAP_LE_PHY_2M) ? 2 : 1;
+  uint32_t sdu_len = len + NOTIFY_HDR_LEN;
+  uint32_t pdu_len, pdus, pdu_us, window;
+
+  if (bt_conn_get_info(conn, &conn_info) || info->tx_octets == 0) {
+    return max;
+  }
+
+  pdu_len = MIN(sdu_len, info->tx_octets);
+  pdus = DIV_ROUND_UP(sdu_len, info->tx_octets);
+
+  // Data PDU, T_IFS, empty ack from the central, T_IFS
+  pdu_us = (pdu_len + PDU_OVERHEAD_LEN) * 8 / rate + T_IFS_US +
+           EMPTY_PDU_LEN * 8 / rate + T_IFS_US;
+  window = MIN(conn_info.le.interval * 1250U,
+               CONFIG_APP_CONN_TUNING_EVENT_LEN_US) /
+           (pdus * pdu_us);
+
+  return CLAMP(window, 1, max);
+}
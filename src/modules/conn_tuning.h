@@ -0,0 +1,67 @@
+#ifndef ST_BLE_CONN_TUNING_H_
+#define ST_BLE_CONN_TUNING_H_
+
+#include <stdint.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Link parameters negotiated for one connection
+struct conn_tuning_info {
+  // ATT MTU
+  uint16_t mtu;
+  // LL payload octets per PDU we may send
+  uint16_t tx_octets;
+  // BT_GAP_LE_PHY_1M or BT_GAP_LE_PHY_2M
+  uint8_t tx_phy;
+  // Procedures the peer refused, bits of enum conn_tuning_proc
+  uint8_t refused;
+};
+
+enum conn_tuning_proc {
+  CONN_TUNING_MTU = BIT(0),
+  CONN_TUNING_DLE = BIT(1),
+  CONN_TUNING_PHY = BIT(2),
+};
+
+#if IS_ENABLED(CONFIG_APP_CONN_TUNING)
+void conn_tuning_init(void);
+
+// Current link parameters, defaults until the procedures complete
+void conn_tuning_get(struct bt_conn* conn, struct conn_tuning_info* info);
+
+// Packets of len bytes the link can carry in one connection event, clamped
+// to [1, max]. Used to size the notification pipeline: with the default
+// 7.5 ms event, 21 byte records give 5 at 1M without data length extension,
+// 10 with it and 14 on 2M.
+uint8_t conn_tuning_tx_window(struct bt_conn* conn, uint16_t len, uint8_t max);
+#else
+static inline void conn_tuning_init(void) {}
+
+// Whatever the host negotiated on its own, nothing is known to be refused
+static inline void conn_tuning_get(struct bt_conn* conn,
+                                   struct conn_tuning_info* info) {
+  *info = (struct conn_tuning_info){
+      .mtu = bt_gatt_get_mtu(conn),
+      .tx_octets = 27,
+      .tx_phy = BT_GAP_LE_PHY_1M,
+  };
+}
+
+static inline uint8_t conn_tuning_tx_window(struct bt_conn* conn, uint16_t len,
+                                            uint8_t max) {
+  return max;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_CONN_TUNING_H_ */
@@ -0,0 +1,251 @@
+#include <zephyr/kernel.h>
+
+#define MODULE cuff_pressure
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_CUFF_PRESSURE_LOG_LEVEL);
+
+#include "modules/cuff_pressure.h"
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
+
+#include "bpm.h"
+#include "log_ratelimit.h"
+#include "modules/eatt.h"
+
+#define RING_SIZE CONFIG_APP_CUFF_PRESSURE_RING_SIZE
+#define COALESCE_MAX CONFIG_APP_CUFF_PRESSURE_COALESCE_MAX
+
+// Flags, cuff pressure, then unused diastolic and MAP fields set to NaN
+#define ICP_LEN (1 + 3 * 2)
+#define ATT_NOTIFY_HDR_LEN 3
+
+BUILD_ASSERT(IS_POWER_OF_TWO(RING_SIZE), "Ring indexes wrap by masking");
+
+struct sample {
+  // 0.1 mmHg, or 0.1 kPa with CONFIG_APP_BPM_UNIT_KPA
+  int16_t pressure;
+  uint32_t cycles;
+};
+
+// Single producer (timer ISR), single consumer (tx thread). Each side only
+// writes its own index, so no lock is needed.
+static struct sample ring[RING_SIZE];
+static atomic_t ring_head;
+static atomic_t ring_tail;
+
+static const struct bt_gatt_attr* icp_attr;
+static K_SEM_DEFINE(ready, 0, 1);
+
+static struct {
+  atomic_t samples;
+  atomic_t overflow;
+  atomic_t notifications;
+  atomic_t coalesced;
+} stats;
+
+static struct k_spinlock latency_lock;
+static uint32_t latency_min_us = UINT32_MAX;
+static uint32_t latency_max_us;
+static uint64_t latency_sum_us;
+static uint32_t latency_count;
+
+// Synthetic waveform: inflate to the top, deflate slowly down to the bottom,
+// with a small oscillation on top like the pulse seen through the cuff.
+#define WAVE_TOP 1800
+#define WAVE_BOTTOM 400
+#define WAVE_INFLATE_STEP (200 / CONFIG_APP_CUFF_PRESSURE_RATE_HZ + 1)
+#define WAVE_DEFLATE_STEP (30 / CONFIG_APP_CUFF_PRESSURE_RATE_HZ + 1)
+#define WAVE_PULSE_AMPLITUDE 20
+// About 72 bpm in samples, at least one at the lowest rate
+#define WAVE_PULSE_PERIOD MAX(CONFIG_APP_CUFF_PRESSURE_RATE_HZ * 5 / 6, 1)
+
+static int16_t wave_level;
+static bool wave_deflating;
+static uint32_t wave_tick;
+
+static int16_t synthetic_sample(void) {
+  int32_t phase = wave_tick++ % WAVE_PULSE_PERIOD;
+  int32_t pulse;
+
+  if (!wave_deflating) {
+    wave_level += WAVE_INFLATE_STEP;
+    wave_deflating = (wave_level >= WAVE_TOP);
+  } else {
+    wave_level -= WAVE_DEFLATE_STEP;
+    if (wave_level <= WAVE_BOTTOM) {
+      wave_level = 0;
+      wave_deflating = false;
+    }
+  }
+
+  // Triangle pulse, only visible while deflating
+  pulse = (phase < WAVE_PULSE_PERIOD / 2) ? phase
+                                          : WAVE_PULSE_PERIOD - phase;
+  pulse = pulse * 2 * WAVE_PULSE_AMPLITUDE / WAVE_PULSE_PERIOD;
+
+  return wave_level + (wave_deflating ? pulse : 0);
+}
+
+static void sample_timer_fn(struct k_timer* timer) {
+  atomic_val_t head = atomic_get(&ring_head);
+  struct sample sample = {
+      .pressure = synthetic_sample(),
+      .cycles = k_cycle_get_32(),
+  };
+
+  ARG_UNUSED(timer);
+
+  atomic_inc(&stats.samples);
+
+  if (head - atomic_get(&ring_tail) >= RING_SIZE) {
+    atomic_inc(&stats.overflow);
+    return;
+  }
+
+  ring[head & (RING_SIZE - 1)] = sample;
+  atomic_set(&ring_head, head + 1);
+  k_sem_give(&ready);
+}
+
+static K_TIMER_DEFINE(sample_timer, sample_timer_fn, NULL);
+
+static void notify_done(struct bt_conn* conn, void* user_data) {
+  uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - (uintptr_t)user_data);
+  k_spinlock_key_t key = k_spin_lock(&latency_lock);
+
+  ARG_UNUSED(conn);
+
+  latency_min_us = MIN(latency_min_us, us);
+  latency_max_us = MAX(latency_max_us, us);
+  latency_sum_us += us;
+  latency_count++;
+  k_spin_unlock(&latency_lock, key);
+}
+
+struct batch {
+  struct net_buf_simple* buf;
+  uint32_t cycles;
+  // Samples per notification the smallest subscribed MTU allows
+  size_t max;
+};
+
+static void min_mtu(struct bt_conn* conn, void* data) {
+  struct batch* batch = data;
+
+  if (bt_gatt_is_subscribed(conn, icp_attr, BT_GATT_CCC_NOTIFY)) {
+    batch->max =
+        MIN(batch->max, (bt_gatt_get_mtu(conn) - ATT_NOTIFY_HDR_LEN) / ICP_LEN);
+  }
+}
+
+static void notify_batch(struct bt_conn* conn, void* data) {
+  struct batch* batch = data;
+  struct bt_gatt_notify_params params = {
+      .attr = icp_attr,
+      .data = batch->buf->data,
+      .len = batch->buf->len,
+      .func = notify_done,
+      .user_data = (void*)(uintptr_t)batch->cycles,
+  };
+  int err;
+
+  if (!bt_gatt_is_subscribed(conn, icp_attr, BT_GATT_CCC_NOTIFY)) {
+    return;
+  }
+  EATT_SET_CHAN_OPT(&params, conn, EATT_CLASS_LIVE);
+
+  // Blocks in this thread while the host is out of buffers, the ring keeps
+  // filling meanwhile and the next notification carries more samples.
+  err = bt_gatt_notify_cb(conn, &params);
+  if (err) {
+    LOG_RATELIMIT(LOG_DBG, "Notification failed (err %d)", err);
+    return;
+  }
+  atomic_inc(&stats.notifications);
+}
+
+// Send up to one notification worth of samples, oldest first. Several ICP
+// values are packed back to back when the link fell behind; collectors that
+// only expect one value per notification read the oldest.
+static void send_batch(void) {
+  NET_BUF_SIMPLE_DEFINE(buf, ICP_LEN * COALESCE_MAX);
+  struct batch batch = {.buf = &buf, .max = COALESCE_MAX};
+  atomic_val_t tail = atomic_get(&ring_tail);
+  size_t n = atomic_get(&ring_head) - tail;
+
+  bt_conn_foreach(BT_CONN_TYPE_LE, min_mtu, &batch);
+  n = MIN(n, MAX(batch.max, 1));
+  batch.cycles = ring[tail & (RING_SIZE - 1)].cycles;
+
+  for (size_t i = 0; i < n; i++) {
+    const struct sample* s = &ring[(tail + i) & (RING_SIZE - 1)];
+
+    net_buf_simple_add_u8(&buf, BPM_FLAGS & BPM_FLAG_UNIT_KPA);
+    net_buf_simple_add_le16(&buf, SFLOAT(s->pressure, -1));
+    net_buf_simple_add_le16(&buf, SFLOAT_NAN);
+    net_buf_simple_add_le16(&buf, SFLOAT_NAN);
+  }
+
+  bt_conn_foreach(BT_CONN_TYPE_LE, notify_batch, &batch);
+
+  if (n > 1) {
+    atomic_add(&stats.coalesced, n);
+  }
+  atomic_set(&ring_tail, tail + n);
+}
+
+static void tx_thread_fn(void) {
+  while (true) {
+    k_sem_take(&ready, K_FOREVER);
+    while (atomic_get(&ring_head) != atomic_get(&ring_tail)) {
+      send_batch();
+    }
+  }
+}
+
+K_THREAD_DEFINE(cuff_pressure_tx, CONFIG_APP_CUFF_PRESSURE_STACK_SIZE,
+                tx_thread_fn, NULL, NULL, NULL,
+                CONFIG_APP_CUFF_PRESSURE_THREAD_PRIORITY, 0, 0);
+
+void cuff_pressure_init(const struct bt_gatt_attr* attr) {
+  icp_attr = attr;
+}
+
+void cuff_pressure_start(void) {
+  k_timeout_t period = K_USEC(USEC_PER_SEC / CONFIG_APP_CUFF_PRESSURE_RATE_HZ);
+
+  wave_level = 0;
+  wave_deflating = false;
+  k_timer_start(&sample_timer, period, period);
+  LOG_INF("Sampling at %d Hz", CONFIG_APP_CUFF_PRESSURE_RATE_HZ);
+}
+
+void cuff_pressure_stop(void) {
+  struct cuff_pressure_stats s;
+
+  k_timer_stop(&sample_timer);
+
+  cuff_pressure_get_stats(&s);
+  LOG_INF("%u samples, %u overflow, %u notifications, %u coalesced, "
+          "latency %u/%u/%u us min/avg/max",
+          s.samples, s.overflow, s.notifications, s.coalesced,
+          s.latency_min_us, s.latency_avg_us, s.latency_max_us);
+}
+
+void cuff_pressure_get_stats(struct cuff_pressure_stats* out) {
+  k_spinlock_key_t key = k_spin_lock(&latency_lock);
+
+  out->latency_min_us = latency_count ? latency_min_us : 0;
+  out->latency_max_us = latency_max_us;
+  out->latency_avg_us = latency_count ? latency_sum_us / latency_count : 0;
+  k_spin_unlock(&latency_lock, key);
+
+  out->samples = atomic_get(&stats.samples);
+  out->overflow = atomic_get(&stats.overflow);
+  out->notifications = atomic_get(&stats.notifications);
+  out->coalesced = atomic_get(&stats.coalesced);
+}
@@ -0,0 +1,46 @@
+#ifndef ST_BLE_CUFF_PRESSURE_H_
+#define ST_BLE_CUFF_PRESSURE_H_
+
+#include <stdint.h>
+
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct cuff_pressure_stats {
+  // Samples produced by the timer
+  uint32_t samples;
+  // Samples lost because the ring was full
+  uint32_t overflow;
+  // Notifications handed to the host, and samples that shared one
+  uint32_t notifications;
+  uint32_t coalesced;
+  // Sample production to TX complete, oldest sample of each notification
+  uint32_t latency_min_us;
+  uint32_t latency_max_us;
+  uint32_t latency_avg_us;
+};
+
+#if IS_ENABLED(CONFIG_APP_CUFF_PRESSURE)
+// Cache the Intermediate Cuff Pressure value attribute
+void cuff_pressure_init(const struct bt_gatt_attr* attr);
+
+// Start and stop sampling, i.e. cuff inflation
+void cuff_pressure_start(void);
+void cuff_pressure_stop(void);
+
+void cuff_pressure_get_stats(struct cuff_pressure_stats* stats);
+#else
+static inline void cuff_pressure_init(const struct bt_gatt_attr* attr) {}
+static inline void cuff_pressure_start(void) {}
+static inline void cuff_pressure_stop(void) {}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_CUFF_PRESSURE_H_ */
@@ -0,0 +1,153 @@
+#include <zephyr/kernel.h>
+
+#define MODULE diag_svc
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_DIAG_SVC_LOG_LEVEL);
+
+#include <string.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/sys/util.h>
+
+#include "modules/energy.h"
+#include "modules/sys_stats.h"
+#include "modules/trace.h"
+
+// Vendor diagnostics service, 8d1a0000-4c7e-4b7b-9a3e-2b5f3c6d7e80
+#define DIAG_UUID(id) \
+  BT_UUID_128_ENCODE(0x8d1a0000 | (id), 0x4c7e, 0x4b7b, 0x9a3e, 0x2b5f3c6d7e80)
+
+static struct bt_uuid_128 diag_uuid = BT_UUID_INIT_128(DIAG_UUID(0x0000));
+
+#if IS_ENABLED(CONFIG_APP_TRACE)
+static struct bt_uuid_128 trace_uuid = BT_UUID_INIT_128(DIAG_UUID(0x0001));
+
+// Stage, count, then min, avg, max and p99 in us, all little endian
+#define TRACE_ENTRY_LEN (1 + 4 * 5)
+
+// Long value, read blob requests re-encode it and may see newer samples
+static ssize_t trace_read(struct bt_conn* conn, const struct bt_gatt_attr* attr,
+                          void* buf, uint16_t len, uint16_t offset) {
+  NET_BUF_SIMPLE_DEFINE(value, TRACE_STAGE_COUNT * TRACE_ENTRY_LEN);
+  struct trace_stats s;
+
+  for (size_t i = 0; i < TRACE_STAGE_COUNT; i++) {
+    trace_get_stats(i, &s);
+    net_buf_simple_add_u8(&value, i);
+    net_buf_simple_add_le32(&value, s.count);
+    net_buf_simple_add_le32(&value, s.min_us);
+    net_buf_simple_add_le32(&value, s.avg_us);
+    net_buf_simple_add_le32(&value, s.max_us);
+    net_buf_simple_add_le32(&value, s.p99_us);
+  }
+
+  return bt_gatt_attr_read(conn, attr, buf, len, offset, value.data,
+                           value.len);
+}
+
+#define TRACE_CHRC                                                        \
+  BT_GATT_CHARACTERISTIC(&trace_uuid.uuid, BT_GATT_CHRC_READ,             \
+                         BT_GATT_PERM_READ, trace_read, NULL, NULL),
+#else
+#define TRACE_CHRC
+#endif
+
+#if IS_ENABLED(CONFIG_APP_SYS_STATS)
+static struct bt_uuid_128 sys_uuid = BT_UUID_INIT_128(DIAG_UUID(0x0002));
+
+// CPU load in 0.1 %, period in ms, heap size, used and max used, thread
+// count, all little endian
+#define SYS_HDR_LEN (2 + 4 + 4 * 3 + 1)
+// Name, NUL padded, stack size and high-water mark, CPU share in 0.1 %
+#define SYS_ENTRY_LEN (SYS_STATS_NAME_LEN + 4 + 4 + 2)
+
+static ssize_t sys_read(struct bt_conn* conn, const struct bt_gatt_attr* attr,
+                        void* buf, uint16_t len, uint16_t offset) {
+  // Up to 1.4 KiB with 64 threads, too much for the RX stack. Called from
+  // the RX thread only, the static copies are not shared.
+  NET_BUF_SIMPLE_DEFINE_STATIC(
+      value, SYS_HDR_LEN + CONFIG_APP_SYS_STATS_MAX_THREADS * SYS_ENTRY_LEN);
+  static struct sys_stats_thread threads[CONFIG_APP_SYS_STATS_MAX_THREADS];
+  struct sys_stats_heap heap;
+  size_t n;
+
+  net_buf_simple_reset(&value);
+  n = sys_stats_threads(threads, ARRAY_SIZE(threads));
+  sys_stats_heap(&heap);
+
+  net_buf_simple_add_le16(&value, sys_stats_cpu_load());
+  net_buf_simple_add_le32(&value, sys_stats_period_ms());
+  net_buf_simple_add_le32(&value, heap.size);
+  net_buf_simple_add_le32(&value, heap.used);
+  net_buf_simple_add_le32(&value, heap.max_used);
+  net_buf_simple_add_u8(&value, n);
+
+  for (size_t i = 0; i < n; i++) {
+    char* name = net_buf_simple_add(&value, SYS_STATS_NAME_LEN);
+
+    strncpy(name, threads[i].name, SYS_STATS_NAME_LEN);
+    net_buf_simple_add_le32(&value, threads[i].stack_size);
+    net_buf_simple_add_le32(&value, threads[i].stack_used);
+    net_buf_simple_add_le16(&value, threads[i].cpu_permille);
+  }
+
+  return bt_gatt_attr_read(conn, attr, buf, len, offset, value.data,
+                           value.len);
+}
+
+#define SYS_CHRC                                                          \
+  BT_GATT_CHARACTERISTIC(&sys_uuid.uuid, BT_GATT_CHRC_READ,               \
+                         BT_GATT_PERM_READ, sys_read, NULL, NULL),
+#else
+#define SYS_CHRC
+#endif
+
+#if IS_ENABLED(CONFIG_APP_ENERGY)
+static struct bt_uuid_128 energy_uuid = BT_UUID_INIT_128(DIAG_UUID(0x0003));
+
+// State count, then per state time in s and charge in nAh; consumer count,
+// then per consumer charge in nAh; then advertising events, connection
+// events, data PDUs sent, flash writes, measurements and connections. All
+// uint32 little endian, the counts uint8.
+#define ENERGY_VALUE_LEN \
+  (1 + ENERGY_STATE_COUNT * 8 + 1 + ENERGY_PART_COUNT * 4 + 6 * 4)
+
+static ssize_t energy_read(struct bt_conn* conn,
+                           const struct bt_gatt_attr* attr, void* buf,
+                           uint16_t len, uint16_t offset) {
+  NET_BUF_SIMPLE_DEFINE(value, ENERGY_VALUE_LEN);
+  struct energy_report r;
+
+  energy_get(&r);
+
+  net_buf_simple_add_u8(&value, ENERGY_STATE_COUNT);
+  for (size_t i = 0; i < ENERGY_STATE_COUNT; i++) {
+    net_buf_simple_add_le32(&value, r.state_ms[i] / 1000);
+    net_buf_simple_add_le32(&value, r.state_nc[i] / 3600);
+  }
+  net_buf_simple_add_u8(&value, ENERGY_PART_COUNT);
+  for (size_t i = 0; i < ENERGY_PART_COUNT; i++) {
+    net_buf_simple_add_le32(&value, r.part_nc[i] / 3600);
+  }
+  net_buf_simple_add_le32(&value, r.adv_events);
+  net_buf_simple_add_le32(&value, r.conn_events);
+  net_buf_simple_add_le32(&value, r.tx_pdus);
+  net_buf_simple_add_le32(&value, r.flash_writes);
+  net_buf_simple_add_le32(&value, r.measurements);
+  net_buf_simple_add_le32(&value, r.connections);
+
+  return bt_gatt_attr_read(conn, attr, buf, len, offset, value.data,
+                           value.len);
+}
+
+#define ENERGY_CHRC                                                       \
+  BT_GATT_CHARACTERISTIC(&energy_uuid.uuid, BT_GATT_CHRC_READ,            \
+                         BT_GATT_PERM_READ, energy_read, NULL, NULL),
+#else
+#define ENERGY_CHRC
+#endif
+
+BT_GATT_SERVICE_DEFINE(diag_svc, BT_GATT_PRIMARY_SERVICE(&diag_uuid),
+                       TRACE_CHRC SYS_CHRC ENERGY_CHRC);
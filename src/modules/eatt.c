@@ -0,0 +1,88 @@
+#include <zephyr/kernel.h>
+
+#define MODULE eatt
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_EATT_LOG_LEVEL);
+
+#include "modules/eatt.h"
+
+#include <string.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/shell/shell.h>
+
+// Every class on the unenhanced bearer, as without EATT, for comparisons
+static bool legacy_only;
+
+// Sends per class on their own bearers or sharing one
+static struct {
+  atomic_t separate;
+  atomic_t shared;
+} stats[EATT_CLASS_COUNT];
+
+static const char* const class_names[EATT_CLASS_COUNT] = {
+    [EATT_CLASS_LIVE] = "live",
+    [EATT_CLASS_BULK] = "bulk",
+};
+
+enum bt_att_chan_opt eatt_chan_opt(struct bt_conn* conn, enum eatt_class cls) {
+  // The stack connects the enhanced bearers itself once the link is
+  // encrypted and the central supports them, CONFIG_BT_EATT_AUTO_CONNECT.
+  // Without a connection the stack sends to every subscriber.
+  if (conn == NULL || legacy_only || bt_eatt_count(conn) == 0) {
+    atomic_inc(&stats[cls].shared);
+    return legacy_only ? BT_ATT_CHAN_OPT_UNENHANCED_ONLY
+                       : BT_ATT_CHAN_OPT_NONE;
+  }
+
+  atomic_inc(&stats[cls].separate);
+  return cls == EATT_CLASS_BULK ? BT_ATT_CHAN_OPT_UNENHANCED_ONLY
+                                : BT_ATT_CHAN_OPT_ENHANCED_ONLY;
+}
+
+#if IS_ENABLED(CONFIG_APP_EATT_SHELL)
+static void show_conn(struct bt_conn* conn, void* data) {
+  const struct shell* sh = data;
+  char addr[BT_ADDR_LE_STR_LEN];
+
+  bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
+  shell_print(sh, "%s: %zu enhanced bearers", addr, bt_eatt_count(conn));
+}
+
+static int cmd_eatt_show(const struct shell* sh, size_t argc, char** argv) {
+  shell_print(sh, "Legacy only: %s", legacy_only ? "on" : "off");
+  bt_conn_foreach(BT_CONN_TYPE_LE, show_conn, (void*)sh);
+  for (size_t i = 0; i < EATT_CLASS_COUNT; i++) {
+    shell_print(sh, "%-5s %8ld separate %8ld shared", class_names[i],
+                atomic_get(&stats[i].separate), atomic_get(&stats[i].shared));
+  }
+  return 0;
+}
+
+static int cmd_eatt_legacy(const struct shell* sh, size_t argc, char** argv) {
+  if (!strcmp(argv[1], "on")) {
+    legacy_only = true;
+  } else if (!strcmp(argv[1], "off")) {
+    legacy_only = false;
+  } else {
+    shell_error(sh, "Usage: eatt legacy <on|off>");
+    return -EINVAL;
+  }
+  for (size_t i = 0; i < EATT_CLASS_COUNT; i++) {
+    atomic_clear(&stats[i].separate);
+    atomic_clear(&stats[i].shared);
+  }
+  shell_print(sh, "Legacy only %s", argv[1]);
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    eatt_cmds,
+    SHELL_CMD(show, NULL, "Enhanced bearers and sends per traffic class",
+              cmd_eatt_show),
+    SHELL_CMD_ARG(legacy, NULL, "<on|off> keep everything on one bearer",
+                  cmd_eatt_legacy, 2, 0),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(eatt, &eatt_cmds, "Enhanced ATT bearers", NULL);
+#endif
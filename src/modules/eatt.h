@@ -0,0 +1,40 @@
+#ifndef ST_BLE_EATT_H_
+#define ST_BLE_EATT_H_
+
+#include <zephyr/bluetooth/att.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Server initiated GATT traffic, kept on separate ATT bearers so a bulk
+// transfer does not hold up live values. Diagnostics are reads, answered on
+// the bearer the central asked on.
+enum eatt_class {
+  // Measurements, RACP responses and cuff pressure: the enhanced bearers
+  EATT_CLASS_LIVE,
+  // History chunks: the unenhanced bearer
+  EATT_CLASS_BULK,
+
+  EATT_CLASS_COUNT
+};
+
+#if IS_ENABLED(CONFIG_APP_EATT)
+// Bearer option for the class, no restriction when the central has no
+// enhanced bearers (yet), so the traffic falls back to the unenhanced one
+enum bt_att_chan_opt eatt_chan_opt(struct bt_conn* conn, enum eatt_class cls);
+
+// Fill the chan_opt of notify or indicate parameters
+#define EATT_SET_CHAN_OPT(params, conn, cls) \
+  ((params)->chan_opt = eatt_chan_opt((conn), (cls)))
+#else
+#define EATT_SET_CHAN_OPT(params, conn, cls) ((void)(cls))
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_EATT_H_ */
@@ -0,0 +1,316 @@
+#include <zephyr/kernel.h>
+
+#define MODULE energy
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_ENERGY_LOG_LEVEL);
+
+#include "modules/energy.h"
+
+#include <string.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/init.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/spinlock.h>
+
+#include "advertising.h"
+#include "app_state.h"
+#include "bps_sender.h"
+#include "energy_def.h"
+#include "modules/led_state.h"
+#include "modules/record_store.h"
+
+#define PERIOD K_MSEC(CONFIG_APP_ENERGY_PERIOD_MS)
+
+// nC to nAh
+#define NC_PER_NAH 3600
+
+// Advertising interval of each phase, see advertising.c. Undirected and low
+// duty directed advertising use the fast interval 2 range, its low end is
+// taken. High duty directed advertising sends every 3.75 ms at most.
+static const uint32_t adv_interval_us[ADV_PHASE_COUNT] = {
+    [ADV_PHASE_DIRECTED_HIGH] = 3750,
+    [ADV_PHASE_DIRECTED_LOW] = BT_GAP_ADV_FAST_INT_MIN_2 * 625,
+    [ADV_PHASE_UNDIRECTED] = BT_GAP_ADV_FAST_INT_MIN_2 * 625,
+};
+
+static const char* const state_names[ENERGY_STATE_COUNT] = {
+    [ENERGY_STATE_IDLE] = "idle",
+    [ENERGY_STATE_ADVERTISING] = "advertising",
+    [ENERGY_STATE_CONNECTED] = "connected",
+};
+
+static const char* const part_names[ENERGY_PART_COUNT] = {
+    [ENERGY_PART_CPU] = "cpu",
+    [ENERGY_PART_SLEEP] = "sleep",
+    [ENERGY_PART_ADV] = "adv",
+    [ENERGY_PART_CONN] = "conn",
+    [ENERGY_PART_TX] = "tx",
+    [ENERGY_PART_FLASH] = "flash",
+    [ENERGY_PART_LED] = "led",
+};
+
+static struct k_spinlock lock;
+static struct energy_report totals;
+// Radio events in 1/1000, the periods are not multiples of the intervals
+static uint64_t adv_mevents;
+static uint64_t conn_mevents;
+static atomic_t connections;
+
+// Only touched by the sampler: counters at the previous sample
+static struct {
+  int64_t uptime_ms;
+  uint64_t busy_cycles;
+  struct bps_sender_stats sender;
+  struct record_store_stats store;
+  uint32_t state_writes;
+  uint64_t led_ms[ENERGY_MAX_LEDS];
+} prev;
+
+struct conn_walk {
+  uint32_t count;
+  uint64_t mevents;
+  uint64_t period_us;
+  bool sending;
+};
+
+static void sample_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(sample_work, sample_work_fn);
+
+static void count_conn(struct bt_conn* conn, void* data) {
+  struct conn_walk* walk = data;
+  struct bt_conn_info info;
+  uint64_t interval_us;
+
+  if (bt_conn_get_info(conn, &info) || info.state != BT_CONN_STATE_CONNECTED ||
+      info.le.interval == 0) {
+    return;
+  }
+
+  // The peripheral skips up to latency events while it has nothing to send
+  interval_us = info.le.interval * 1250ULL;
+  if (!walk->sending) {
+    interval_us *= info.le.latency + 1;
+  }
+  walk->count++;
+  walk->mevents += walk->period_us * 1000 / interval_us;
+}
+
+static void read_counters(struct bps_sender_stats* sender,
+                          struct record_store_stats* store,
+                          uint32_t* state_writes) {
+  struct app_state_stats state;
+
+  bps_sender_get_stats(sender);
+  memset(store, 0, sizeof(*store));
+  if (IS_ENABLED(CONFIG_APP_RECORD_STORE)) {
+    record_store_get_stats(store);
+  }
+  app_state_get_stats(&state);
+  *state_writes = state.writes;
+}
+
+static void sample(void) {
+  const struct energy_model* m = &energy_model;
+  int64_t now = k_uptime_get();
+  uint64_t period_us = (now - prev.uptime_ms) * 1000ULL;
+  uint64_t part[ENERGY_PART_COUNT] = {0};
+  uint64_t led_ms[ENERGY_MAX_LEDS] = {0};
+  k_thread_runtime_stats_t all;
+  struct bps_sender_stats sender;
+  struct record_store_stats store;
+  uint32_t state_writes, writes, bytes, tx, acked;
+  uint64_t active_us, led_on_ms = 0, adv = 0;
+  enum adv_phase phase = advertising_phase();
+  struct conn_walk walk = {.period_us = period_us};
+  enum energy_state state;
+  size_t leds;
+
+  if (period_us == 0) {
+    return;
+  }
+
+  k_thread_runtime_stats_all_get(&all);
+  active_us = MIN(k_cyc_to_us_floor64(all.total_cycles - prev.busy_cycles),
+                  period_us);
+  part[ENERGY_PART_CPU] = active_us * m->cpu_active_ua / 1000;
+  part[ENERGY_PART_SLEEP] = (period_us - active_us) * m->sleep_na / 1000000;
+
+  read_counters(&sender, &store, &state_writes);
+  tx = sender.sent - prev.sender.sent;
+  acked = sender.acked - prev.sender.acked;
+  writes = (store.batches_written - prev.store.batches_written) +
+           (state_writes - prev.state_writes);
+  bytes = store.bytes_written - prev.store.bytes_written;
+
+  if (phase != ADV_PHASE_IDLE) {
+    adv = period_us * 1000 / adv_interval_us[phase];
+  }
+  walk.sending = tx > 0;
+  bt_conn_foreach(BT_CONN_TYPE_LE, count_conn, &walk);
+
+  part[ENERGY_PART_ADV] = adv * m->adv_event_nc / 1000;
+  part[ENERGY_PART_CONN] = walk.mevents * m->conn_event_nc / 1000;
+  part[ENERGY_PART_TX] = (uint64_t)tx * m->tx_pdu_nc;
+  part[ENERGY_PART_FLASH] =
+      (uint64_t)writes * m->flash_write_nc + (uint64_t)bytes * m->flash_byte_nc;
+
+  leds = led_state_on_ms(led_ms, ENERGY_MAX_LEDS);
+  for (size_t i = 0; i < leds; i++) {
+    uint64_t on_ms = led_ms[i] - prev.led_ms[i];
+
+    // uA x ms is nC
+    part[ENERGY_PART_LED] += on_ms * m->led_ua[i];
+    led_on_ms += on_ms;
+  }
+
+  if (walk.count > 0) {
+    state = ENERGY_STATE_CONNECTED;
+  } else if (phase != ADV_PHASE_IDLE) {
+    state = ENERGY_STATE_ADVERTISING;
+  } else {
+    state = ENERGY_STATE_IDLE;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&lock);
+
+  totals.state_ms[state] += period_us / 1000;
+  for (size_t i = 0; i < ENERGY_PART_COUNT; i++) {
+    totals.part_nc[i] += part[i];
+    totals.state_nc[state] += part[i];
+  }
+  adv_mevents += adv;
+  conn_mevents += walk.mevents;
+  totals.tx_pdus += tx;
+  totals.flash_writes += writes;
+  totals.flash_bytes += bytes;
+  totals.cpu_active_us += active_us;
+  totals.led_on_ms += led_on_ms;
+  totals.measurements += acked;
+  k_spin_unlock(&lock, key);
+
+  prev.uptime_ms = now;
+  prev.busy_cycles = all.total_cycles;
+  prev.sender = sender;
+  prev.store = store;
+  prev.state_writes = state_writes;
+  memcpy(prev.led_ms, led_ms, sizeof(prev.led_ms));
+}
+
+static void sample_work_fn(struct k_work* work) {
+  ARG_UNUSED(work);
+
+  sample();
+  k_work_reschedule(&sample_work, PERIOD);
+}
+
+void energy_get(struct energy_report* out) {
+  k_spinlock_key_t key = k_spin_lock(&lock);
+
+  *out = totals;
+  out->adv_events = adv_mevents / 1000;
+  out->conn_events = conn_mevents / 1000;
+  k_spin_unlock(&lock, key);
+  out->connections = atomic_get(&connections);
+}
+
+void energy_reset(void) {
+  k_spinlock_key_t key = k_spin_lock(&lock);
+
+  memset(&totals, 0, sizeof(totals));
+  adv_mevents = 0;
+  conn_mevents = 0;
+  k_spin_unlock(&lock, key);
+  atomic_clear(&connections);
+}
+
+const char* energy_state_name(enum energy_state state) {
+  return state_names[state];
+}
+
+const char* energy_part_name(enum energy_part part) {
+  return part_names[part];
+}
+
+static void connected(struct bt_conn* conn, uint8_t err) {
+  ARG_UNUSED(conn);
+
+  if (!err) {
+    atomic_inc(&connections);
+  }
+}
+
+BT_CONN_CB_DEFINE(energy_conn_callbacks) = {
+    .connected = connected,
+};
+
+static int energy_init(void) {
+  k_thread_runtime_stats_t all;
+
+  k_thread_runtime_stats_all_get(&all);
+  prev.uptime_ms = k_uptime_get();
+  prev.busy_cycles = all.total_cycles;
+  read_counters(&prev.sender, &prev.store, &prev.state_writes);
+  led_state_on_ms(prev.led_ms, ENERGY_MAX_LEDS);
+
+  k_work_schedule(&sample_work, PERIOD);
+  return 0;
+}
+
+SYS_INIT(energy_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if IS_ENABLED(CONFIG_APP_ENERGY_SHELL)
+// nC as uAh with three decimals
+#define UAH_FMT "%u.%03u uAh"
+#define UAH_ARG(nc) \
+  (uint32_t)((nc) / NC_PER_NAH / 1000), (uint32_t)((nc) / NC_PER_NAH % 1000)
+
+static int cmd_energy_show(const struct shell* sh, size_t argc, char** argv) {
+  struct energy_report r;
+
+  energy_get(&r);
+
+  for (size_t i = 0; i < ENERGY_STATE_COUNT; i++) {
+    // nC per ms is uA, so also uAh per hour
+    uint64_t ua_x10 = r.state_nc[i] * 10 / MAX(r.state_ms[i], 1);
+
+    shell_print(sh, "%-11s %8llu s " UAH_FMT ", avg %u.%u uA",
+                state_names[i], r.state_ms[i] / 1000, UAH_ARG(r.state_nc[i]),
+                (uint32_t)(ua_x10 / 10), (uint32_t)(ua_x10 % 10));
+  }
+  for (size_t i = 0; i < ENERGY_PART_COUNT; i++) {
+    shell_print(sh, "%-11s " UAH_FMT, part_names[i], UAH_ARG(r.part_nc[i]));
+  }
+  shell_print(sh, "%u adv events, %u conn events, %u tx pdus, %u flash writes "
+              "(%u bytes)",
+              r.adv_events, r.conn_events, r.tx_pdus, r.flash_writes,
+              r.flash_bytes);
+  shell_print(sh, "cpu active %llu ms, leds lit %llu ms",
+              r.cpu_active_us / 1000, r.led_on_ms);
+  // Only what they cause: the PDUs a measurement goes out in, and the
+  // connection events of a link. Sleep and CPU are not split up.
+  shell_print(sh, "%u measurements, " UAH_FMT " tx each", r.measurements,
+              UAH_ARG(r.part_nc[ENERGY_PART_TX] / MAX(r.measurements, 1)));
+  shell_print(sh, "%u connections, " UAH_FMT " conn events each",
+              r.connections,
+              UAH_ARG(r.part_nc[ENERGY_PART_CONN] / MAX(r.connections, 1)));
+  return 0;
+}
+
+static int cmd_energy_reset(const struct shell* sh, size_t argc,
+                            char** argv) {
+  energy_reset();
+  shell_print(sh, "Energy accounting reset");
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    energy_cmds,
+    SHELL_CMD(show, NULL, "Estimated charge per state and consumer",
+              cmd_energy_show),
+    SHELL_CMD(reset, NULL, "Start counting from now", cmd_energy_reset),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(energy, &energy_cmds, "Energy accounting", NULL);
+#endif
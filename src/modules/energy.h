@@ -0,0 +1,85 @@
+#ifndef ST_BLE_ENERGY_H_
+#define ST_BLE_ENERGY_H_
+
+#include <stdint.h>
+
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ENERGY_MAX_LEDS 8
+
+// Current model of a board, see configuration/<board>/energy_def.h. Charges
+// are in nC (nA x s), 1 uAh is 3600000 nC.
+struct energy_model {
+  // CPU running, from the non idle cycles
+  uint32_t cpu_active_ua;
+  // System ON with the RTC running, the rest of the time
+  uint32_t sleep_na;
+  // One advertising event on all three channels, radio and CPU wake-up
+  uint32_t adv_event_nc;
+  // One connection event with an empty PDU each way
+  uint32_t conn_event_nc;
+  // A data PDU sent in a connection event, on top of conn_event_nc
+  uint32_t tx_pdu_nc;
+  // A settings write, then per byte written
+  uint32_t flash_write_nc;
+  uint32_t flash_byte_nc;
+  // Each LED lit, in the order of enum led_id in led_state_def.h
+  uint16_t led_ua[ENERGY_MAX_LEDS];
+};
+
+// What the device was doing, connected wins over advertising
+enum energy_state {
+  ENERGY_STATE_IDLE,
+  ENERGY_STATE_ADVERTISING,
+  ENERGY_STATE_CONNECTED,
+
+  ENERGY_STATE_COUNT
+};
+
+enum energy_part {
+  ENERGY_PART_CPU,
+  ENERGY_PART_SLEEP,
+  ENERGY_PART_ADV,
+  ENERGY_PART_CONN,
+  ENERGY_PART_TX,
+  ENERGY_PART_FLASH,
+  ENERGY_PART_LED,
+
+  ENERGY_PART_COUNT
+};
+
+struct energy_report {
+  uint64_t state_ms[ENERGY_STATE_COUNT];
+  uint64_t state_nc[ENERGY_STATE_COUNT];
+  uint64_t part_nc[ENERGY_PART_COUNT];
+  // Counted or, for the radio events, estimated from the intervals
+  uint32_t adv_events;
+  uint32_t conn_events;
+  uint32_t tx_pdus;
+  uint32_t flash_writes;
+  uint32_t flash_bytes;
+  uint64_t cpu_active_us;
+  uint64_t led_on_ms;
+  // Acknowledged or confirmed by a central
+  uint32_t measurements;
+  uint32_t connections;
+};
+
+#if IS_ENABLED(CONFIG_APP_ENERGY)
+// Totals since boot or the last energy_reset(), up to the latest sample
+void energy_get(struct energy_report* report);
+void energy_reset(void);
+
+const char* energy_state_name(enum energy_state state);
+const char* energy_part_name(enum energy_part part);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_ENERGY_H_ */
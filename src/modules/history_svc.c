@@ -0,0 +1,463 @@
+#include <zephyr/kernel.h>
+
+#define MODULE history_svc
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_HISTORY_SVC_LOG_LEVEL);
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/util.h>
+
+#include "bpm.h"
+#include "modules/eatt.h"
+#include "modules/record_store.h"
+
+// Vendor bulk history service, 8d1b0000-4c7e-4b7b-9a3e-2b5f3c6d7e80
+#define HISTORY_UUID(id) \
+  BT_UUID_128_ENCODE(0x8d1b0000 | (id), 0x4c7e, 0x4b7b, 0x9a3e, 0x2b5f3c6d7e80)
+
+static struct bt_uuid_128 history_uuid = BT_UUID_INIT_128(HISTORY_UUID(0x0000));
+
+static struct bt_uuid_128 data_uuid = BT_UUID_INIT_128(HISTORY_UUID(0x0001));
+
+static struct bt_uuid_128 ctrl_uuid = BT_UUID_INIT_128(HISTORY_UUID(0x0002));
+
+// Index of the data characteristic value in history_svc.attrs
+#define DATA_ATTR_IDX 2
+
+// Control point: start with the first record seq and the first chunk number,
+// both carried over from the last chunk received when resuming
+#define CTRL_OP_START 0x01
+#define CTRL_OP_ABORT 0x02
+#define CTRL_START_LEN (1 + 4 + 2)
+
+// Same ATT error codes as the RACP
+#define CTRL_ERR_IN_PROGRESS 0xfe
+#define CTRL_ERR_CCC_CONFIG 0xfd
+// The unenhanced bearer's MTU can't hold a chunk with one record in it
+#define CTRL_ERR_MTU 0xfc
+
+// Chunk: chunk number (le16), first record seq (le32), record count, the
+// records, CRC-16/CCITT-FALSE (le16) over everything before it. A chunk
+// without records ends the transfer.
+#define CHUNK_HDR_LEN (2 + 4 + 1)
+#define CHUNK_CRC_LEN 2
+#define CHUNK_MAX_LEN (CONFIG_BT_L2CAP_TX_MTU - 3)
+
+// BPM flags bit 7 is reserved in BLS, here it marks a sequence gap
+#define REC_FLAG_SEQ_GAP BIT(7)
+
+// Flags, gap, three pressures, time, pulse rate, user and status as varints
+#define RECORD_ENC_MAX (1 + 5 + 3 * 3 + 5 + 3 + 2 + 3)
+#define CHUNK_MIN_LEN (CHUNK_HDR_LEN + RECORD_ENC_MAX + CHUNK_CRC_LEN)
+
+// Wait for buffers taken by other traffic when no chunk of ours is queued
+#define HISTORY_RETRY_MS 5
+
+// Values of the previous record in the chunk, zero at the chunk start so
+// each chunk decodes on its own
+struct delta_base {
+  uint32_t seq;
+  uint16_t systolic;
+  uint16_t diastolic;
+  uint16_t mean_arterial;
+  uint32_t time;
+  uint16_t pulse_rate;
+  uint8_t user_id;
+  uint16_t status;
+};
+
+static struct history_ctx {
+  atomic_t busy;
+  // Set from the RX thread (abort op, disconnect), read by the work item
+  atomic_t abort;
+  // End chunk handed to the host, the transfer is over once it is sent
+  bool ended;
+  // Referenced while busy. Taken by whichever of chunk_sent() and
+  // disconnected() releases the transfer.
+  atomic_ptr_t conn;
+  uint32_t next_seq;
+  uint16_t chunk;
+  atomic_t in_flight;
+  uint32_t records;
+  uint32_t bytes;
+  int64_t started;
+  struct k_work_delayable work;
+} history_ctx[CONFIG_BT_MAX_CONN];
+
+static ssize_t ctrl_write(struct bt_conn* conn, const struct bt_gatt_attr* attr,
+                          const void* buf, uint16_t len, uint16_t offset,
+                          uint8_t flags);
+
+BT_GATT_SERVICE_DEFINE(
+    history_svc, BT_GATT_PRIMARY_SERVICE(&history_uuid),
+    BT_GATT_CHARACTERISTIC(&data_uuid.uuid, BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_NONE, NULL, NULL, NULL),
+    BT_GATT_CCC(NULL, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE_ENCRYPT),
+    BT_GATT_CHARACTERISTIC(&ctrl_uuid.uuid, BT_GATT_CHRC_WRITE,
+                           BT_GATT_PERM_WRITE_ENCRYPT, NULL, ctrl_write,
+                           NULL), );
+
+static void put_varint(struct net_buf_simple* buf, uint32_t value) {
+  while (value >= 0x80) {
+    net_buf_simple_add_u8(buf, (value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  net_buf_simple_add_u8(buf, value);
+}
+
+// Signed deltas as zigzag varints, small changes either way take one byte
+static void put_delta(struct net_buf_simple* buf, int32_t delta) {
+  put_varint(buf, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+}
+
+static int encode_record(struct net_buf_simple* buf, uint32_t seq,
+                         const struct bps_record* record,
+                         struct delta_base* base) {
+  struct bpm_measurement m;
+  int flags = bpm_decode(record->data, record->len, &m);
+
+  if (flags < 0) {
+    return flags;
+  }
+
+  if (seq != base->seq + 1) {
+    net_buf_simple_add_u8(buf, flags | REC_FLAG_SEQ_GAP);
+    put_varint(buf, seq - base->seq - 1);
+  } else {
+    net_buf_simple_add_u8(buf, flags);
+  }
+  base->seq = seq;
+
+  // SFLOAT deltas are only small while the exponent stays, which it does
+  put_delta(buf, (int16_t)(m.systolic - base->systolic));
+  put_delta(buf, (int16_t)(m.diastolic - base->diastolic));
+  put_delta(buf, (int16_t)(m.mean_arterial - base->mean_arterial));
+  base->systolic = m.systolic;
+  base->diastolic = m.diastolic;
+  base->mean_arterial = m.mean_arterial;
+
+  if (flags & BPM_FLAG_TIME_STAMP) {
+    uint32_t time = bpm_time_to_secs(&m.time_stamp);
+
+    put_delta(buf, (int32_t)(time - base->time));
+    base->time = time;
+  }
+  if (flags & BPM_FLAG_PULSE_RATE) {
+    put_delta(buf, (int16_t)(m.pulse_rate - base->pulse_rate));
+    base->pulse_rate = m.pulse_rate;
+  }
+  if (flags & BPM_FLAG_USER_ID) {
+    put_delta(buf, (int8_t)(m.user_id - base->user_id));
+    base->user_id = m.user_id;
+  }
+  if (flags & BPM_FLAG_STATUS) {
+    put_delta(buf, (int16_t)(m.status - base->status));
+    base->status = m.status;
+  }
+  return 0;
+}
+
+struct chunk_builder {
+  struct history_ctx* h;
+  struct net_buf_simple* buf;
+  struct delta_base base;
+  uint8_t count;
+};
+
+// Add records while they fit, leaving room for the CRC
+static bool chunk_add_cb(uint32_t seq, const struct bps_record* record,
+                         void* user_data) {
+  struct chunk_builder* b = user_data;
+  struct delta_base base = b->base;
+  NET_BUF_SIMPLE_DEFINE(rec, RECORD_ENC_MAX);
+
+  if (atomic_get(&b->h->abort) || b->count == UINT8_MAX) {
+    return false;
+  }
+  // The chunk starts at its first record, even past a gap
+  if (b->count == 0) {
+    base.seq = seq - 1;
+  }
+
+  if (encode_record(&rec, seq, record, &base)) {
+    LOG_WRN("Record %u not decodable, skipped", seq);
+    return true;
+  }
+  if (net_buf_simple_tailroom(b->buf) < rec.len + CHUNK_CRC_LEN) {
+    return false;
+  }
+
+  if (b->count == 0) {
+    sys_put_le32(seq, &b->buf->data[2]);
+  }
+  net_buf_simple_add_mem(b->buf, rec.data, rec.len);
+  b->base = base;
+  b->count++;
+  b->h->next_seq = seq + 1;
+  return true;
+}
+
+static void history_release(struct history_ctx* h) {
+  struct bt_conn* conn = atomic_ptr_clear(&h->conn);
+  int64_t elapsed = MAX(k_uptime_get() - h->started, 1);
+
+  if (!conn) {
+    return;
+  }
+
+  LOG_INF("History: %u records, %u B in %lld ms, next chunk %u%s",
+          h->records, h->bytes, elapsed, h->chunk,
+          atomic_get(&h->abort) ? ", aborted" : "");
+
+  bt_conn_unref(conn);
+  atomic_clear(&h->busy);
+}
+
+static void chunk_sent(struct bt_conn* conn, void* user_data) {
+  struct history_ctx* h = user_data;
+
+  atomic_val_t in_flight = atomic_dec(&h->in_flight);
+
+  ARG_UNUSED(conn);
+
+  // Completions for a transfer released at disconnect may still trickle in
+  if (in_flight <= 0) {
+    atomic_set(&h->in_flight, 0);
+    return;
+  }
+  if (in_flight == 1 && h->ended) {
+    history_release(h);
+    return;
+  }
+  k_work_reschedule(&h->work, K_NO_WAIT);
+}
+
+// Keep CONFIG_APP_HISTORY_MAX_IN_FLIGHT chunks queued in the host
+static void history_work_fn(struct k_work* work) {
+  struct k_work_delayable* dwork = k_work_delayable_from_work(work);
+  struct history_ctx* h = CONTAINER_OF(dwork, struct history_ctx, work);
+  struct bt_conn* conn = atomic_ptr_get(&h->conn);
+  uint8_t chunk[CHUNK_MAX_LEN];
+  struct net_buf_simple buf;
+  int err;
+
+  if (!conn) {
+    return;
+  }
+
+  while (!h->ended &&
+         atomic_get(&h->in_flight) < CONFIG_APP_HISTORY_MAX_IN_FLIGHT) {
+    uint32_t from_seq = h->next_seq;
+    struct chunk_builder b = {.h = h, .buf = &buf};
+    struct bt_gatt_notify_params params = {
+        .attr = &history_svc.attrs[DATA_ATTR_IDX],
+        .func = chunk_sent,
+        .user_data = h,
+    };
+    // Chunks go on the unenhanced bearer, see EATT_CLASS_BULK.
+    // bt_gatt_get_mtu() is the largest MTU of all bearers.
+    size_t len = MIN(sizeof(chunk), bt_gatt_get_uatt_mtu(conn) - 3);
+
+    net_buf_simple_init_with_data(&buf, chunk, len);
+    net_buf_simple_reset(&buf);
+    net_buf_simple_add_le16(&buf, h->chunk);
+    net_buf_simple_add_le32(&buf, h->next_seq);
+    net_buf_simple_add_u8(&buf, 0);
+
+    if (!atomic_get(&h->abort)) {
+      err = record_store_foreach(h->next_seq, chunk_add_cb, &b);
+      if (err) {
+        LOG_WRN("Record store read failed (err %d)", err);
+        atomic_set(&h->abort, 1);
+      }
+    }
+
+    chunk[CHUNK_HDR_LEN - 1] = b.count;
+    net_buf_simple_add_le16(&buf, crc16_itu_t(0xffff, buf.data, buf.len));
+
+    params.data = buf.data;
+    params.len = buf.len;
+    EATT_SET_CHAN_OPT(&params, conn, EATT_CLASS_BULK);
+    // The completion of the end chunk may release the transfer before
+    // bt_gatt_notify_cb() returns, account for it up front
+    atomic_inc(&h->in_flight);
+    h->ended = (b.count == 0);
+    h->chunk++;
+    h->records += b.count;
+    h->bytes += buf.len;
+
+    err = bt_gatt_notify_cb(conn, &params);
+    if (err == -ENOMEM || err == -ENOBUFS) {
+      // Out of buffers, maybe to live traffic: build it again once an
+      // earlier chunk is sent, or shortly if none is outstanding
+      h->next_seq = from_seq;
+      h->ended = false;
+      h->chunk--;
+      h->records -= b.count;
+      h->bytes -= buf.len;
+      if (atomic_dec(&h->in_flight) == 1) {
+        k_work_schedule(&h->work, K_MSEC(HISTORY_RETRY_MS));
+      }
+      return;
+    }
+    if (err) {
+      LOG_WRN("Chunk %u not sent (err %d)", h->chunk - 1, err);
+      atomic_set(&h->abort, 1);
+      h->ended = true;
+      if (atomic_dec(&h->in_flight) == 1) {
+        history_release(h);
+      }
+      return;
+    }
+  }
+}
+
+static ssize_t ctrl_write(struct bt_conn* conn, const struct bt_gatt_attr* attr,
+                          const void* buf, uint16_t len, uint16_t offset,
+                          uint8_t flags) {
+  struct history_ctx* h = &history_ctx[bt_conn_index(conn)];
+  const uint8_t* req = buf;
+
+  ARG_UNUSED(attr);
+  ARG_UNUSED(flags);
+
+  if (offset) {
+    return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+  }
+  if (len < 1) {
+    return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+  }
+
+  switch (req[0]) {
+    case CTRL_OP_START:
+      if (len != CTRL_START_LEN) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+      }
+      if (!bt_gatt_is_subscribed(conn, &history_svc.attrs[DATA_ATTR_IDX],
+                                 BT_GATT_CCC_NOTIFY)) {
+        return BT_GATT_ERR(CTRL_ERR_CCC_CONFIG);
+      }
+      if (bt_gatt_get_uatt_mtu(conn) - 3 < CHUNK_MIN_LEN) {
+        return BT_GATT_ERR(CTRL_ERR_MTU);
+      }
+      if (!atomic_cas(&h->busy, 0, 1)) {
+        return BT_GATT_ERR(CTRL_ERR_IN_PROGRESS);
+      }
+      atomic_ptr_set(&h->conn, bt_conn_ref(conn));
+      atomic_clear(&h->abort);
+      h->ended = false;
+      h->next_seq = MAX(sys_get_le32(&req[1]), 1);
+      h->chunk = sys_get_le16(&req[5]);
+      h->records = 0;
+      h->bytes = 0;
+      h->started = k_uptime_get();
+      k_work_reschedule(&h->work, K_NO_WAIT);
+      return len;
+    case CTRL_OP_ABORT:
+      if (atomic_get(&h->busy)) {
+        atomic_set(&h->abort, 1);
+      }
+      return len;
+    default:
+      return BT_GATT_ERR(BT_ATT_ERR_NOT_SUPPORTED);
+  }
+}
+
+
+static void disconnected(struct bt_conn* conn, uint8_t reason) {
+  struct history_ctx* h = &history_ctx[bt_conn_index(conn)];
+
+  ARG_UNUSED(reason);
+
+  // The host drops the chunks still queued without calling chunk_sent(),
+  // release here like bps_sender does
+  if (atomic_get(&h->busy) && atomic_ptr_get(&h->conn) == conn) {
+    struct k_work_sync sync;
+
+    atomic_set(&h->abort, 1);
+    k_work_cancel_delayable_sync(&h->work, &sync);
+    h->ended = true;
+    atomic_set(&h->in_flight, 0);
+    history_release(h);
+  }
+}
+
+BT_CONN_CB_DEFINE(history_conn_callbacks) = {
+    .disconnected = disconnected,
+};
+
+static int history_init(void) {
+  for (size_t i = 0; i < ARRAY_SIZE(history_ctx); i++) {
+    k_work_init_delayable(&history_ctx[i].work, history_work_fn);
+  }
+  return 0;
+}
+
+SYS_INIT(history_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if IS_ENABLED(CONFIG_APP_HISTORY_SHELL)
+// 2025-01-01 00:00:00, start of the synthetic history
+#define FILL_EPOCH 1735689600
+#define FILL_INTERVAL_S 300
+
+static int cmd_history_fill(const struct shell* sh, size_t argc, char** argv) {
+  NET_BUF_SIMPLE_DEFINE(buf, BPM_ENCODED_LEN);
+  uint32_t count = strtoul(argv[1], NULL, 0);
+  struct bpm_measurement m = {0};
+  int seq = 0;
+
+  ARG_UNUSED(argc);
+
+  for (uint32_t i = 0; i < count; i++) {
+    time_t secs = FILL_EPOCH + (time_t)i * FILL_INTERVAL_S;
+    struct tm tm;
+
+    // Slow drift plus a little noise, like a day of readings
+    m.systolic = SFLOAT(118 + (i / 7) % 15 + i % 3, 0);
+    m.diastolic = SFLOAT(76 + (i / 5) % 9, 0);
+    m.mean_arterial = SFLOAT(90 + (i / 6) % 11, 0);
+    m.pulse_rate = SFLOAT(64 + i % 9, 0);
+    // A few people sharing the device, in runs like morning readings
+    m.user_id = 1 + (i / 3) % 4;
+
+    gmtime_r(&secs, &tm);
+    m.time_stamp.year = tm.tm_year + 1900;
+    m.time_stamp.month = tm.tm_mon + 1;
+    m.time_stamp.day = tm.tm_mday;
+    m.time_stamp.hours = tm.tm_hour;
+    m.time_stamp.minutes = tm.tm_min;
+    m.time_stamp.seconds = tm.tm_sec;
+
+    net_buf_simple_reset(&buf);
+    bpm_encode(&m, &buf);
+    seq = record_store_append(buf.data, buf.len);
+    if (seq < 0) {
+      shell_error(sh, "Append failed after %u records (err %d)", i, seq);
+      return seq;
+    }
+  }
+
+  record_store_flush();
+  shell_print(sh, "Appended %u records, last seq %d, %u stored", count, seq,
+              record_store_count(0));
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    history_cmds,
+    SHELL_CMD_ARG(fill, NULL, "Append <count> synthetic records",
+                  cmd_history_fill, 2, 0),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(history, &history_cmds, "Bulk history transfer", NULL);
+#endif
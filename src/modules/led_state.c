@@ -0,0 +1,182 @@
+#include <zephyr/kernel.h>
+
+#define MODULE led_state
+#include <caf/events/module_state_event.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_LED_STATE_LOG_LEVEL);
+
+#include "led_state_def.h"
+#include "modules/button_state.h"
+#include "modules/led_state.h"
+
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
+
+BUILD_ASSERT(ARRAY_SIZE(led_state_effect) == LED_STATE_COUNT,
+             "Missing LED effect for a device state");
+
+static enum led_state_id current_state = LED_STATE_COUNT;
+// On-time per LED for the energy accounting, also updated from the timer
+static struct {
+  bool lit;
+  int64_t since_ms;
+  uint64_t on_ms;
+} led_time[LED_ID_COUNT];
+static struct k_spinlock time_lock;
+// LEDs toggled by the blink timer in the current state
+static uint32_t blink_mask;
+static bool initialized;
+
+static void apply_fn(struct k_work* work);
+static void blink_fn(struct k_timer* timer);
+static void reset_done_fn(struct k_timer* timer);
+
+static K_WORK_DEFINE(apply_work, apply_fn);
+static K_TIMER_DEFINE(blink_timer, blink_fn, NULL);
+static K_TIMER_DEFINE(reset_timer, reset_done_fn, NULL);
+
+static enum led_state_id get_led_state(void) {
+  atomic_val_t bits = atomic_get(&get_status()->status_bits);
+
+  return (enum led_state_id)((((bits & BIT(BONDED)) ? 1 : 0) << 2) |
+                             (((bits & BIT(CONNECTED)) ? 1 : 0) << 1) |
+                             ((bits & BIT(ADV_ENABLE)) ? 0 : 1));
+}
+
+static void set_led(size_t i, bool lit) {
+  k_spinlock_key_t key = k_spin_lock(&time_lock);
+  int64_t now = k_uptime_get();
+
+  if (led_time[i].lit) {
+    led_time[i].on_ms += now - led_time[i].since_ms;
+  }
+  led_time[i].lit = lit;
+  led_time[i].since_ms = now;
+  k_spin_unlock(&time_lock, key);
+
+  gpio_pin_set_dt(&led_gpio[i], lit);
+}
+
+static void blink_fn(struct k_timer* timer) {
+  ARG_UNUSED(timer);
+
+  for (size_t i = 0; i < LED_ID_COUNT; i++) {
+    if (blink_mask & BIT(i)) {
+      set_led(i, !led_time[i].lit);
+    }
+  }
+}
+
+static void reset_done_fn(struct k_timer* timer) {
+  ARG_UNUSED(timer);
+  led_state_update();
+}
+
+static void set_effect(enum led_state_id state) {
+  const struct led_state_effect* effect = &led_state_effect[state];
+
+  k_timer_stop(&blink_timer);
+  blink_mask = 0;
+
+  for (size_t i = 0; i < LED_ID_COUNT; i++) {
+    // Blinking LEDs start lit so they toggle in phase with each other
+    set_led(i, effect->pattern[i] != LED_PATTERN_OFF);
+    if (effect->pattern[i] == LED_PATTERN_BLINK) {
+      blink_mask |= BIT(i);
+    }
+  }
+
+  if (blink_mask && effect->blink_ms) {
+    k_timer_start(&blink_timer, K_MSEC(effect->blink_ms),
+                  K_MSEC(effect->blink_ms));
+  }
+
+  current_state = state;
+  LOG_DBG("LED state %d", state);
+}
+
+static void apply_fn(struct k_work* work) {
+  ARG_UNUSED(work);
+
+  if (atomic_test_and_clear_bit(&get_status()->status_bits, RESET)) {
+    set_effect(LED_STATE_RESET);
+    k_timer_start(&reset_timer, K_MSEC(LED_RESET_EFFECT_MS), K_NO_WAIT);
+    return;
+  }
+
+  // Hold the reset effect until its timer expires
+  if (k_timer_remaining_get(&reset_timer) > 0) {
+    return;
+  }
+
+  enum led_state_id state = get_led_state();
+
+  if (state != current_state) {
+    set_effect(state);
+  }
+}
+
+size_t led_state_on_ms(uint64_t* on_ms, size_t max) {
+  k_spinlock_key_t key = k_spin_lock(&time_lock);
+  int64_t now = k_uptime_get();
+  size_t n = MIN(max, LED_ID_COUNT);
+
+  for (size_t i = 0; i < n; i++) {
+    on_ms[i] = led_time[i].on_ms +
+               (led_time[i].lit ? now - led_time[i].since_ms : 0);
+  }
+  k_spin_unlock(&time_lock, key);
+  return n;
+}
+
+void led_state_update(void) {
+  if (initialized) {
+    k_work_submit(&apply_work);
+  }
+}
+
+static int leds_init(void) {
+  for (size_t i = 0; i < LED_ID_COUNT; i++) {
+    if (!gpio_is_ready_dt(&led_gpio[i])) {
+      LOG_ERR("LED %zu GPIO not ready", i);
+      return -ENODEV;
+    }
+
+    int err = gpio_pin_configure_dt(&led_gpio[i], GPIO_OUTPUT_INACTIVE);
+
+    if (err) {
+      LOG_ERR("Cannot configure LED %zu (err %d)", i, err);
+      return err;
+    }
+  }
+
+  initialized = true;
+  led_state_update();
+  return 0;
+}
+
+static bool app_event_handler(const struct app_event_header* aeh) {
+  if (is_module_state_event(aeh)) {
+    const struct module_state_event* event = cast_module_state_event(aeh);
+
+    if (check_state(event, MODULE_ID(main), MODULE_STATE_READY)) {
+      if (leds_init()) {
+        module_set_state(MODULE_STATE_ERROR);
+      } else {
+        module_set_state(MODULE_STATE_READY);
+      }
+    }
+
+    return false;
+  }
+
+  /* Event not handled but subscribed. */
+  __ASSERT_NO_MSG(false);
+
+  return false;
+}
+
+APP_EVENT_LISTENER(MODULE, app_event_handler);
+APP_EVENT_SUBSCRIBE(MODULE, module_state_event);
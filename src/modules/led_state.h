@@ -0,0 +1,53 @@
+#ifndef ST_BLE_LED_STATE_H_
+#define ST_BLE_LED_STATE_H_
+
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Device states shown on the LEDs, one per row of the README status table.
+// The first eight are indexed by (bonded << 2 | connected << 1 | adv off).
+enum led_state_id {
+  LED_STATE_ADV_ON_DISCONNECTED,
+  LED_STATE_ADV_OFF_DISCONNECTED,
+  LED_STATE_ADV_ON_CONNECTED,
+  LED_STATE_ADV_OFF_CONNECTED,
+  LED_STATE_ADV_ON_DISCONNECTED_BONDED,
+  LED_STATE_ADV_OFF_DISCONNECTED_BONDED,
+  LED_STATE_ADV_ON_CONNECTED_BONDED,
+  LED_STATE_ADV_OFF_CONNECTED_BONDED,
+  LED_STATE_RESET,
+
+  LED_STATE_COUNT
+};
+
+enum led_pattern {
+  LED_PATTERN_OFF,
+  LED_PATTERN_ON,
+  // Toggled every blink_ms of the current state effect
+  LED_PATTERN_BLINK,
+};
+
+#if IS_ENABLED(CONFIG_APP_LED_STATE)
+// Re-evaluate the device status bits and switch effect if the state changed.
+// Callable from any context, the work is deferred to the system work queue.
+void led_state_update(void);
+
+// Milliseconds each LED has been lit since boot, in the order of enum led_id
+// of the board's led_state_def.h. Returns the number of LEDs filled in.
+size_t led_state_on_ms(uint64_t* on_ms, size_t max);
+#else
+static inline void led_state_update(void) {}
+
+static inline size_t led_state_on_ms(uint64_t* on_ms, size_t max) {
+  return 0;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_LED_STATE_H_ */
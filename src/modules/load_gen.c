@@ -0,0 +1,330 @@
+#include <zephyr/kernel.h>
+
+#define MODULE load_gen
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_LOAD_GEN_LOG_LEVEL);
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/util.h>
+
+#include "bpm.h"
+#include "bps_sender.h"
+#include "bps_svc.h"
+#include "modules/load_gen.h"
+#include "modules/record_store.h"
+#include "modules/sys_stats.h"
+#include "modules/trace.h"
+
+// Latency histogram: values below 4 us exactly, above in four buckets per
+// power of two, so a percentile is within 25 % of the real value. The last
+// bucket takes everything from 2^24 us (16 s) on.
+#define SUB_BITS 2
+#define BUCKETS ((24 - SUB_BITS + 1) << SUB_BITS)
+
+struct histogram {
+  uint32_t count[BUCKETS];
+  uint32_t total;
+  uint32_t max_us;
+};
+
+static uint32_t interval_ms = CONFIG_APP_LOAD_GEN_INTERVAL_MS;
+static uint32_t burst = CONFIG_APP_LOAD_GEN_BURST;
+static bool running;
+// Next burst, absolute, so a slow burst does not stretch the interval
+static int64_t next_ms;
+// End of the soak, 0 when running until stopped
+static int64_t soak_end_ms;
+
+// Everything since the last start, only written by the generator work item
+static struct {
+  int64_t started_ms;
+  uint32_t bursts;
+  uint32_t submitted;
+  // Rejected on submit, e.g. store not restored yet
+  uint32_t failed;
+  // Bursts that found records of the previous one still queued
+  uint32_t late_bursts;
+  uint32_t depth_max;
+  uint64_t depth_sum;
+  uint16_t cpu_max;
+  struct bps_sender_stats sender_base;
+  struct record_store_stats store_base;
+  // One bps_svc_submit_measurement(): encode, store and enqueue
+  struct histogram submit;
+} soak;
+
+static void gen_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(gen_work, gen_work_fn);
+
+static size_t bucket_of(uint32_t us) {
+  uint32_t msb;
+
+  if (us < BIT(SUB_BITS)) {
+    return us;
+  }
+  msb = 31 - __builtin_clz(us);
+  if (msb >= 24) {
+    return BUCKETS - 1;
+  }
+  return ((msb - SUB_BITS + 1) << SUB_BITS) +
+         ((us >> (msb - SUB_BITS)) & BIT_MASK(SUB_BITS));
+}
+
+// Largest value that falls into the bucket
+static uint32_t bucket_top(size_t b) {
+  uint32_t shift;
+
+  if (b < BIT(SUB_BITS)) {
+    return b;
+  }
+  shift = (b >> SUB_BITS) - 1;
+  return (((BIT(SUB_BITS) | (b & BIT_MASK(SUB_BITS))) + 1) << shift) - 1;
+}
+
+static void histogram_add(struct histogram* h, uint32_t us) {
+  h->count[bucket_of(us)]++;
+  h->total++;
+  h->max_us = MAX(h->max_us, us);
+}
+
+// Percentile in 0.1 %
+static uint32_t histogram_pct(const struct histogram* h, uint32_t permille) {
+  uint32_t rank = DIV_ROUND_UP((uint64_t)h->total * permille, 1000);
+  uint32_t seen = 0;
+
+  for (size_t b = 0; b < BUCKETS; b++) {
+    seen += h->count[b];
+    if (seen >= rank && seen > 0) {
+      return MIN(bucket_top(b), h->max_us);
+    }
+  }
+  return 0;
+}
+
+static size_t queue_depth(void) {
+  return CONFIG_APP_BPS_SENDER_QUEUE_LEN - bps_sender_space();
+}
+
+// To the shell when called from a command, to the log at the end of a soak
+#define REPORT(sh, fmt, ...)               \
+  do {                                     \
+    if (sh) {                              \
+      shell_print(sh, fmt, ##__VA_ARGS__); \
+    } else {                               \
+      LOG_INF(fmt, ##__VA_ARGS__);         \
+    }                                      \
+  } while (0)
+
+static void report(const struct shell* sh) {
+  int64_t elapsed_ms = MAX(k_uptime_get() - soak.started_ms, 1);
+  struct bps_sender_stats sender;
+  struct record_store_stats store = {0};
+  uint32_t overflow, dropped;
+
+  bps_sender_get_stats(&sender);
+  overflow = sender.overflow - soak.sender_base.overflow;
+  dropped = sender.dropped - soak.sender_base.dropped;
+  if (IS_ENABLED(CONFIG_APP_RECORD_STORE)) {
+    record_store_get_stats(&store);
+  }
+
+  REPORT(sh, "Load %u x %u ms for %lld s, %s", burst, interval_ms,
+         elapsed_ms / 1000, running ? "running" : "stopped");
+  REPORT(sh, "submitted %u (%lld/s), failed %u, queue full %u, dropped %u",
+         soak.submitted, soak.submitted * 1000LL / elapsed_ms, soak.failed,
+         overflow, dropped);
+  REPORT(sh, "sent %u, acked %u, stored %u in %u batches",
+         sender.sent - soak.sender_base.sent,
+         sender.acked - soak.sender_base.acked,
+         store.appended - soak.store_base.appended,
+         store.batches_written - soak.store_base.batches_written);
+  REPORT(sh, "queue max %u of %u, avg %u after a burst, %u late bursts of %u",
+         soak.depth_max, CONFIG_APP_BPS_SENDER_QUEUE_LEN,
+         (uint32_t)(soak.depth_sum / MAX(soak.bursts, 1)), soak.late_bursts,
+         soak.bursts);
+  REPORT(sh, "submit us p50 %u p90 %u p99 %u p99.9 %u max %u",
+         histogram_pct(&soak.submit, 500), histogram_pct(&soak.submit, 900),
+         histogram_pct(&soak.submit, 990), histogram_pct(&soak.submit, 999),
+         soak.submit.max_us);
+
+#if IS_ENABLED(CONFIG_APP_TRACE)
+  struct trace_stats t;
+
+  trace_get_stats(TRACE_TX_COMPLETE, &t);
+  REPORT(sh, "tx_complete us avg %u p99 %u max %u over %u bursts", t.avg_us,
+         t.p99_us, t.max_us, t.count);
+#endif
+
+#if IS_ENABLED(CONFIG_APP_SYS_STATS)
+  static struct sys_stats_thread threads[CONFIG_APP_SYS_STATS_MAX_THREADS];
+  struct sys_stats_heap heap;
+  size_t n = sys_stats_threads(threads, ARRAY_SIZE(threads));
+
+  sys_stats_heap(&heap);
+  REPORT(sh, "cpu max %u.%u %%, heap max %u of %u", soak.cpu_max / 10,
+         soak.cpu_max % 10, heap.max_used, heap.size);
+  for (size_t i = 0; i < n; i++) {
+    REPORT(sh, "stack %.*s max %u of %u", SYS_STATS_NAME_LEN,
+           threads[i].name, threads[i].stack_used, threads[i].stack_size);
+  }
+#endif
+}
+
+static void gen_work_fn(struct k_work* work) {
+  struct bpm_measurement m = {
+      .diastolic = SFLOAT(80, 0),
+      .mean_arterial = SFLOAT(95, 0),
+      .pulse_rate = SFLOAT(70, 0),
+      .user_id = 1,
+  };
+  size_t depth = queue_depth();
+
+  ARG_UNUSED(work);
+
+  if (!running) {
+    return;
+  }
+
+  soak.bursts++;
+  soak.late_bursts += depth > 0;
+  // Latency of the first record of the burst to the stages of the notify
+  // path, "trace show", when a central is subscribed
+  trace_begin(TRACE_PATH_NOTIFY);
+
+  for (uint32_t i = 0; i < burst; i++) {
+    uint32_t start = k_cycle_get_32();
+    int seq;
+
+    // Distinct values so every record differs
+    m.systolic = SFLOAT(100 + soak.submitted % 80, 0);
+    m.taken_at = k_uptime_get();
+    seq = bps_svc_submit_measurement(&m);
+    histogram_add(&soak.submit,
+                  k_cyc_to_us_floor32(k_cycle_get_32() - start));
+    soak.submitted++;
+    soak.failed += seq < 0;
+
+    depth = queue_depth();
+    soak.depth_max = MAX(soak.depth_max, depth);
+  }
+  soak.depth_sum += depth;
+
+#if IS_ENABLED(CONFIG_APP_SYS_STATS)
+  soak.cpu_max = MAX(soak.cpu_max, sys_stats_cpu_load());
+#endif
+
+  if (soak_end_ms && k_uptime_get() >= soak_end_ms) {
+    running = false;
+    LOG_INF("Soak done");
+    report(NULL);
+    return;
+  }
+
+  next_ms += interval_ms;
+  // Behind by more than a burst: skip ahead instead of catching up
+  next_ms = MAX(next_ms, k_uptime_get());
+  k_work_reschedule(&gen_work, K_TIMEOUT_ABS_MS(next_ms));
+}
+
+// Restart the statistics and the generator, minutes 0 runs until stopped
+static void start(uint32_t minutes) {
+  struct k_work_sync sync;
+
+  // Wait for a burst in progress, the statistics are the work item's
+  k_work_cancel_delayable_sync(&gen_work, &sync);
+  memset(&soak, 0, sizeof(soak));
+  bps_sender_get_stats(&soak.sender_base);
+  if (IS_ENABLED(CONFIG_APP_RECORD_STORE)) {
+    record_store_get_stats(&soak.store_base);
+  }
+#if IS_ENABLED(CONFIG_APP_TRACE)
+  trace_reset();
+#endif
+
+  soak.started_ms = k_uptime_get();
+  soak_end_ms = minutes ? soak.started_ms + minutes * 60000LL : 0;
+  next_ms = soak.started_ms;
+  running = true;
+  LOG_INF("Load %u records every %u ms%s", burst, interval_ms,
+          minutes ? ", soak" : "");
+  k_work_reschedule(&gen_work, K_NO_WAIT);
+}
+
+#if IS_ENABLED(CONFIG_APP_LOAD_GEN_SHELL)
+// Optional [interval_ms] [burst] from argv[first] on
+static int parse_pattern(const struct shell* sh, size_t argc, char** argv,
+                         size_t first) {
+  long interval = argc > first ? strtol(argv[first], NULL, 0) : interval_ms;
+  long count = argc > first + 1 ? strtol(argv[first + 1], NULL, 0) : burst;
+
+  if (interval <= 0 || count <= 0) {
+    shell_error(sh, "Interval and burst must be positive");
+    return -EINVAL;
+  }
+  interval_ms = interval;
+  burst = count;
+  return 0;
+}
+
+static int cmd_load_start(const struct shell* sh, size_t argc, char** argv) {
+  int err = parse_pattern(sh, argc, argv, 1);
+
+  if (err) {
+    return err;
+  }
+  start(0);
+  shell_print(sh, "Load started");
+  return 0;
+}
+
+static int cmd_load_soak(const struct shell* sh, size_t argc, char** argv) {
+  long minutes = strtol(argv[1], NULL, 0);
+  int err;
+
+  if (minutes <= 0) {
+    shell_error(sh, "Minutes must be positive");
+    return -EINVAL;
+  }
+  err = parse_pattern(sh, argc, argv, 2);
+  if (err) {
+    return err;
+  }
+  start(minutes);
+  shell_print(sh, "Soak started for %ld min", minutes);
+  return 0;
+}
+
+static int cmd_load_stop(const struct shell* sh, size_t argc, char** argv) {
+  running = false;
+  k_work_cancel_delayable(&gen_work);
+  report(sh);
+  return 0;
+}
+
+static int cmd_load_report(const struct shell* sh, size_t argc, char** argv) {
+  report(sh);
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    load_cmds,
+    SHELL_CMD_ARG(start, NULL, "[interval_ms] [burst] until stopped",
+                  cmd_load_start, 1, 2),
+    SHELL_CMD_ARG(soak, NULL, "<minutes> [interval_ms] [burst]", cmd_load_soak,
+                  2, 2),
+    SHELL_CMD(stop, NULL, "Stop and print the report", cmd_load_stop),
+    SHELL_CMD(report, NULL, "Drops, queue depth, latency, stacks and heap",
+              cmd_load_report),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(load, &load_cmds, "Synthetic measurement load", NULL);
+#endif
+
+void load_gen_app_ready(void) {
+  if (CONFIG_APP_LOAD_GEN_SOAK_MINUTES > 0) {
+    start(CONFIG_APP_LOAD_GEN_SOAK_MINUTES);
+  }
+}
@@ -0,0 +1,22 @@
+#ifndef ST_BLE_LOAD_GEN_H_
+#define ST_BLE_LOAD_GEN_H_
+
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if IS_ENABLED(CONFIG_APP_LOAD_GEN)
+// Called once Bluetooth is up and the record store restored, starts the
+// boot soak of CONFIG_APP_LOAD_GEN_SOAK_MINUTES if there is one
+void load_gen_app_ready(void);
+#else
+static inline void load_gen_app_ready(void) {}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_LOAD_GEN_H_ */
@@ -0,0 +1,126 @@
+#include <zephyr/kernel.h>
+
+#define MODULE peer_cache
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_PEER_CACHE_LOG_LEVEL);
+
+#include "modules/conn_tuning.h"
+#include "modules/peer_cache.h"
+
+#include <string.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/settings/settings.h>
+
+#define CACHE_SIZE CONFIG_BT_MAX_PAIRED
+
+// Most recently disconnected peer first
+static struct peer_cache_entry cache[CACHE_SIZE];
+static K_MUTEX_DEFINE(cache_lock);
+
+static void save_work_fn(struct k_work* work);
+static K_WORK_DEFINE(save_work, save_work_fn);
+
+static int cache_set(const char* key, size_t len, settings_read_cb read_cb,
+                     void* cb_arg) {
+  ssize_t rc;
+
+  if (key) {
+    return -ENOENT;
+  }
+
+  k_mutex_lock(&cache_lock, K_FOREVER);
+  memset(cache, 0, sizeof(cache));
+  rc = read_cb(cb_arg, cache, MIN(len, sizeof(cache)));
+  k_mutex_unlock(&cache_lock);
+
+  return (rc < 0) ? rc : 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(app_peer, PEER_CACHE_SUBTREE, NULL, cache_set,
+                               NULL, NULL);
+
+static void save_work_fn(struct k_work* work) {
+  struct peer_cache_entry copy[CACHE_SIZE];
+  int err;
+
+  ARG_UNUSED(work);
+
+  k_mutex_lock(&cache_lock, K_FOREVER);
+  memcpy(copy, cache, sizeof(copy));
+  k_mutex_unlock(&cache_lock);
+
+  err = settings_save_one(PEER_CACHE_SUBTREE, copy, sizeof(copy));
+  if (err) {
+    LOG_WRN("Cannot save peer cache (err %d)", err);
+  }
+}
+
+int peer_cache_get(const bt_addr_le_t* addr, struct peer_cache_entry* entry) {
+  int err = -ENOENT;
+
+  k_mutex_lock(&cache_lock, K_FOREVER);
+  for (size_t i = 0; i < CACHE_SIZE; i++) {
+    if (cache[i].mtu && bt_addr_le_eq(&cache[i].addr, addr)) {
+      *entry = cache[i];
+      err = 0;
+      break;
+    }
+  }
+  k_mutex_unlock(&cache_lock);
+
+  return err;
+}
+
+static void disconnected(struct bt_conn* conn, uint8_t reason) {
+  struct peer_cache_entry entry = {0};
+  struct conn_tuning_info tuning;
+  struct bt_conn_info info;
+  size_t i;
+
+  ARG_UNUSED(reason);
+
+  if (bt_conn_get_info(conn, &info) ||
+      !bt_addr_le_is_bonded(info.id, info.le.dst)) {
+    return;
+  }
+
+  bt_addr_le_copy(&entry.addr, info.le.dst);
+  entry.interval = info.le.interval;
+  entry.latency = info.le.latency;
+  entry.timeout = info.le.timeout;
+
+  conn_tuning_get(conn, &tuning);
+  entry.mtu = tuning.mtu;
+  entry.tx_octets = tuning.tx_octets;
+  entry.tx_phy = tuning.tx_phy;
+  entry.refused = tuning.refused;
+
+  k_mutex_lock(&cache_lock, K_FOREVER);
+
+  for (i = 0; i < CACHE_SIZE - 1; i++) {
+    if (bt_addr_le_eq(&cache[i].addr, &entry.addr)) {
+      break;
+    }
+  }
+
+  if (i == 0 && !memcmp(&cache[0], &entry, sizeof(entry))) {
+    // Nothing new, spare the flash write
+    k_mutex_unlock(&cache_lock);
+    return;
+  }
+
+  // Move to front, dropping the least recent peer if it was not cached
+  memmove(&cache[1], &cache[0], i * sizeof(cache[0]));
+  cache[0] = entry;
+
+  k_mutex_unlock(&cache_lock);
+
+  k_work_submit(&save_work);
+}
+
+BT_CONN_CB_DEFINE(peer_cache_conn_callbacks) = {
+    .disconnected = disconnected,
+};
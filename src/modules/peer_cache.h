@@ -0,0 +1,44 @@
+#ifndef ST_BLE_PEER_CACHE_H_
+#define ST_BLE_PEER_CACHE_H_
+
+#include <errno.h>
+#include <stdint.h>
+
+#include <zephyr/bluetooth/addr.h>
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Settings key of the cache, not needed before the first advertisement
+#define PEER_CACHE_SUBTREE "app/peer"
+
+// Link state a bonded central ended its last connection with
+struct peer_cache_entry {
+  bt_addr_le_t addr;
+  uint16_t mtu;
+  uint16_t tx_octets;
+  uint8_t tx_phy;
+  // Procedures the peer refused, bits of enum conn_tuning_proc
+  uint8_t refused;
+  uint16_t interval;
+  uint16_t latency;
+  uint16_t timeout;
+} __packed;
+
+#if IS_ENABLED(CONFIG_APP_PEER_CACHE)
+// Returns 0 and fills entry if the peer is known, -ENOENT otherwise
+int peer_cache_get(const bt_addr_le_t* addr, struct peer_cache_entry* entry);
+#else
+static inline int peer_cache_get(const bt_addr_le_t* addr,
+                                 struct peer_cache_entry* entry) {
+  return -ENOENT;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_PEER_CACHE_H_ */
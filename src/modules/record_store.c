@@ -0,0 +1,709 @@
+#include <zephyr/kernel.h>
+
+#define MODULE record_store
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_RECORD_STORE_LOG_LEVEL);
+
+#include "bpm.h"
+#include "modules/record_store.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/fs/nvs.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
+
+#define BATCH_SIZE CONFIG_APP_RECORD_STORE_BATCH_SIZE
+#define BATCH_COUNT CONFIG_APP_RECORD_STORE_BATCH_COUNT
+#define EARLY_COUNT CONFIG_APP_RECORD_STORE_EARLY_COUNT
+// A batch that failed to write stays in RAM and is tried again after this
+#define WRITE_RETRY_MS 1000
+// Batches and their index entries live in the settings NVS under fixed ids
+// of their own, below the 0x8000 on settings_nvs uses for names and values.
+// Read by id, a batch costs one lookup instead of a walk over every
+// settings name, and settings loads don't walk the records either.
+#define BATCH_ID(slot) (0x1000 + (slot))
+#define INDEX_ID(slot) (0x1100 + (slot))
+
+BUILD_ASSERT(BATCH_COUNT <= 0x100, "Batch and index ids must not overlap");
+
+// One NVS entry. Records are appended to the RAM batch and the whole batch
+// is written as a single NVS entry once it is full, so NVS only ever sees
+// BATCH_COUNT ids and its own append-only log does the wear levelling.
+// Slots are reused round robin, dropping the oldest batch when the log wraps.
+struct record_batch {
+  uint32_t first_seq;
+  uint8_t count;
+  struct bps_record records[BATCH_SIZE];
+} __packed;
+
+#define BATCH_HDR_LEN offsetof(struct record_batch, records)
+
+// NVS keeps an entry within one sector, next to its ATE and the sector's
+// close and garbage collection ATEs. See CONFIG_APP_RECORD_STORE_BATCH_SIZE.
+BUILD_ASSERT(sizeof(struct record_batch) <= 4096 - 3 * 8,
+             "A record batch must fit in one 4 KiB NVS sector");
+
+// What a query needs to know about a slot to skip it without reading it
+struct slot_index {
+  // BIT(user ID % 32) for every user with a record in the batch
+  uint32_t users;
+  // Range of the known time stamps in seconds since 1970, 0 if none
+  uint32_t time_min;
+  uint32_t time_max;
+};
+
+// Saved after each batch as INDEX_ID(slot). Boot reads these small entries
+// instead of the batches.
+struct index_entry {
+  uint32_t first_seq;
+  uint8_t count;
+  struct slot_index index;
+} __packed;
+
+struct record_filter {
+  uint8_t user;
+  uint32_t since;
+};
+
+static K_MUTEX_DEFINE(store_lock);
+
+// First sequence number and record count of each flash slot, 0 when empty
+static uint32_t slot_first_seq[BATCH_COUNT];
+static uint8_t slot_count[BATCH_COUNT];
+static struct slot_index slot_index[BATCH_COUNT];
+// Slots found without an index entry at boot, indexed once loading is done
+static ATOMIC_DEFINE(unindexed, BATCH_COUNT);
+
+// The settings NVS, set by record_store_init()
+static struct nvs_fs* nvs;
+static struct record_batch pending;
+static struct record_batch scratch;
+static uint32_t next_seq = 1;
+static struct record_store_stats stats;
+// Set once record_store_init() scanned the log
+static atomic_t loaded;
+
+// Appended before that, stored in order once the sequence range is known.
+// Not touched after loaded is set under early_lock.
+static struct bps_record early[EARLY_COUNT];
+static size_t early_count;
+// What record_store_append() returned for each of them in record_store_init()
+static int early_seq[EARLY_COUNT];
+static size_t early_stored;
+static struct k_spinlock early_lock;
+
+static void flush_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(flush_work, flush_work_fn);
+
+static inline size_t slot_of(uint32_t first_seq) {
+  return ((first_seq - 1) / BATCH_SIZE) % BATCH_COUNT;
+}
+
+static inline size_t batch_len(const struct record_batch* batch) {
+  return BATCH_HDR_LEN + batch->count * sizeof(struct bps_record);
+}
+
+static inline uint32_t user_bit(uint8_t user) {
+  return BIT(user % 32);
+}
+
+// User and time of a record, BPM_USER_UNKNOWN and 0 if it has none
+static void record_key(const struct bps_record* record, uint8_t* user,
+                       uint32_t* time) {
+  struct bpm_measurement m;
+  int flags = bpm_decode(record->data, record->len, &m);
+
+  *user = (flags >= 0 && (flags & BPM_FLAG_USER_ID)) ? m.user_id
+                                                     : BPM_USER_UNKNOWN;
+  *time = (flags >= 0 && (flags & BPM_FLAG_TIME_STAMP))
+              ? bpm_time_to_secs(&m.time_stamp)
+              : 0;
+}
+
+static void index_batch(const struct record_batch* batch,
+                        struct slot_index* index) {
+  uint8_t user;
+  uint32_t time;
+
+  memset(index, 0, sizeof(*index));
+  for (uint8_t j = 0; j < batch->count; j++) {
+    record_key(&batch->records[j], &user, &time);
+    index->users |= user_bit(user);
+    if (time) {
+      index->time_min = index->time_min ? MIN(index->time_min, time) : time;
+      index->time_max = MAX(index->time_max, time);
+    }
+  }
+}
+
+static bool index_match(const struct slot_index* index,
+                        const struct record_filter* filter) {
+  return !filter || ((index->users & user_bit(filter->user)) &&
+                     (!filter->since || index->time_max >= filter->since));
+}
+
+static bool record_match(const struct bps_record* record,
+                         const struct record_filter* filter) {
+  uint8_t user;
+  uint32_t time;
+
+  if (!filter) {
+    return true;
+  }
+  record_key(record, &user, &time);
+  return user == filter->user && (!filter->since || time >= filter->since);
+}
+
+// nvs_write() returns the length written, 0 if the entry was unchanged
+static inline int nvs_err(ssize_t rc) {
+  return rc < 0 ? rc : 0;
+}
+
+static int write_index(size_t slot) {
+  const struct index_entry entry = {
+      .first_seq = slot_first_seq[slot],
+      .count = slot_count[slot],
+      .index = slot_index[slot],
+  };
+
+  return nvs_err(nvs_write(nvs, INDEX_ID(slot), &entry, sizeof(entry)));
+}
+
+static int write_batch(const struct record_batch* batch) {
+  size_t slot = slot_of(batch->first_seq);
+  size_t len = batch_len(batch);
+  int err = nvs_err(nvs_write(nvs, BATCH_ID(slot), batch, len));
+
+  if (err) {
+    LOG_ERR("Cannot write batch %u (err %d)", batch->first_seq, err);
+    return err;
+  }
+
+  slot_first_seq[slot] = batch->first_seq;
+  slot_count[slot] = batch->count;
+  index_batch(batch, &slot_index[slot]);
+  stats.batches_written++;
+  stats.bytes_written += len;
+
+  // Batch first: boot re-reads the newest batches, see record_store_init()
+  err = write_index(slot);
+  if (err) {
+    LOG_WRN("Cannot write index %u (err %d)", batch->first_seq, err);
+  } else {
+    stats.bytes_written += sizeof(struct index_entry);
+  }
+
+  LOG_DBG("Batch %u: %zu B for %u records, %u B/record since boot",
+          batch->first_seq, len, batch->count,
+          stats.appended ? stats.bytes_written / stats.appended : 0);
+  return 0;
+}
+
+// An empty batch if the slot was never written or holds no valid batch
+static int load_slot(size_t slot, struct record_batch* batch) {
+  ssize_t rc = nvs_read(nvs, BATCH_ID(slot), batch, sizeof(*batch));
+
+  if (rc == -ENOENT) {
+    batch->count = 0;
+    return 0;
+  }
+  if (rc < 0) {
+    batch->count = 0;
+    return rc;
+  }
+  if (rc < BATCH_HDR_LEN || rc > sizeof(*batch) || batch_len(batch) != rc) {
+    batch->count = 0;
+  }
+  return 0;
+}
+
+static void init_slot(size_t slot) {
+  struct index_entry entry;
+  ssize_t rc = nvs_read(nvs, INDEX_ID(slot), &entry, sizeof(entry));
+
+  if (rc == sizeof(entry) && entry.count > 0 && entry.count <= BATCH_SIZE &&
+      slot_of(entry.first_seq) == slot) {
+    slot_first_seq[slot] = entry.first_seq;
+    slot_count[slot] = entry.count;
+    slot_index[slot] = entry.index;
+    next_seq = MAX(next_seq, entry.first_seq + entry.count);
+    return;
+  }
+
+  // No index entry, e.g. a reset right after the batch write: read the
+  // batch instead
+  if (load_slot(slot, &scratch) || scratch.count == 0 ||
+      slot_of(scratch.first_seq) != slot) {
+    return;
+  }
+
+  slot_first_seq[slot] = scratch.first_seq;
+  slot_count[slot] = scratch.count;
+  index_batch(&scratch, &slot_index[slot]);
+  atomic_set_bit(unindexed, slot);
+  next_seq = MAX(next_seq, scratch.first_seq + scratch.count);
+}
+
+// A reset between writing a batch and its index leaves the index behind:
+// the newest batch may have grown, or the next slot may hold a newer batch
+// than its index says. Both are re-read, no other batch is.
+static void check_newest(void) {
+  size_t last = slot_of(next_seq - 1);
+  size_t next;
+
+  if (next_seq > 1 && load_slot(last, &scratch) == 0 &&
+      scratch.first_seq == slot_first_seq[last] &&
+      scratch.count != slot_count[last]) {
+    slot_count[last] = scratch.count;
+    index_batch(&scratch, &slot_index[last]);
+    atomic_set_bit(unindexed, last);
+    next_seq = scratch.first_seq + scratch.count;
+  }
+
+  next = slot_of(next_seq);
+  if (load_slot(next, &scratch) == 0 && scratch.count > 0 &&
+      scratch.first_seq == next_seq) {
+    slot_first_seq[next] = scratch.first_seq;
+    slot_count[next] = scratch.count;
+    index_batch(&scratch, &slot_index[next]);
+    atomic_set_bit(unindexed, next);
+    next_seq += scratch.count;
+  }
+}
+
+static int append_locked(const uint8_t* data, size_t len);
+
+int record_store_init(void) {
+  int64_t start = k_uptime_get();
+  size_t reindexed = 0;
+  size_t queued;
+  k_spinlock_key_t key;
+  int err = settings_subsys_init();
+
+  if (!err) {
+    err = settings_storage_get((void**)&nvs);
+  }
+  if (err || !nvs) {
+    LOG_ERR("Settings init failed (err %d)", err);
+    return err ?: -ENODEV;
+  }
+
+  k_mutex_lock(&store_lock, K_FOREVER);
+
+  for (size_t slot = 0; slot < BATCH_COUNT; slot++) {
+    init_slot(slot);
+  }
+  check_newest();
+
+  for (size_t slot = 0; slot < BATCH_COUNT; slot++) {
+    if (atomic_test_and_clear_bit(unindexed, slot)) {
+      write_index(slot);
+      reindexed++;
+    }
+  }
+
+  // Keep filling a batch that was flushed before it was full
+  size_t last = slot_of(next_seq - 1);
+
+  if (next_seq > 1 && slot_count[last] < BATCH_SIZE &&
+      load_slot(last, &pending) == 0 && pending.count == slot_count[last]) {
+    LOG_DBG("Resuming batch %u with %u records", pending.first_seq,
+            pending.count);
+  } else {
+    pending.count = 0;
+  }
+
+  key = k_spin_lock(&early_lock);
+  atomic_set(&loaded, 1);
+  queued = early_count;
+  early_count = 0;
+  k_spin_unlock(&early_lock, key);
+
+  // Still under store_lock: appends made from now on wait behind these
+  for (size_t i = 0; i < queued; i++) {
+    early_seq[i] = append_locked(early[i].data, early[i].len);
+  }
+  early_stored = queued;
+
+  LOG_INF("Record store: next seq %u, %u stored, %zu queued at boot, "
+          "%zu batches indexed, %lld ms",
+          next_seq, record_store_count(0), queued, reindexed,
+          k_uptime_get() - start);
+
+  k_mutex_unlock(&store_lock);
+  return err;
+}
+
+// Sequence numbers are unknown until the log was scanned, keep the record
+// for record_store_init(). Returns 0 if queued, 1 if the log is loaded.
+static int append_early(const uint8_t* data, size_t len) {
+  k_spinlock_key_t key = k_spin_lock(&early_lock);
+  int ret = 0;
+
+  if (atomic_get(&loaded)) {
+    ret = 1;
+  } else if (early_count < EARLY_COUNT) {
+    early[early_count].len = len;
+    memcpy(early[early_count].data, data, len);
+    early_count++;
+  } else {
+    ret = -EAGAIN;
+  }
+  k_spin_unlock(&early_lock, key);
+  return ret;
+}
+
+int record_store_early_seq(size_t index) {
+  int seq;
+
+  if (!atomic_get(&loaded)) {
+    return 0;
+  }
+
+  // Waits for record_store_init() to store them
+  k_mutex_lock(&store_lock, K_FOREVER);
+  seq = index < early_stored ? early_seq[index] : -ENOENT;
+  k_mutex_unlock(&store_lock);
+  return seq;
+}
+
+int record_store_append(const uint8_t* data, size_t len) {
+  int seq;
+
+  if (len == 0 || len > BPS_RECORD_MAX_LEN) {
+    return -EINVAL;
+  }
+  if (!atomic_get(&loaded)) {
+    seq = append_early(data, len);
+    if (seq <= 0) {
+      return seq;
+    }
+  }
+
+  k_mutex_lock(&store_lock, K_FOREVER);
+  seq = append_locked(data, len);
+  k_mutex_unlock(&store_lock);
+  return seq;
+}
+
+// Caller holds store_lock. A full batch starts over once written, one that
+// could not be written stays in RAM and flush_work tries again.
+static int write_pending(void) {
+  int err = write_batch(&pending);
+
+  if (err) {
+    k_work_reschedule(&flush_work, K_MSEC(WRITE_RETRY_MS));
+    return err;
+  }
+  if (pending.count == BATCH_SIZE) {
+    pending.count = 0;
+    k_work_cancel_delayable(&flush_work);
+  }
+  return 0;
+}
+
+// Caller holds store_lock
+static int append_locked(const uint8_t* data, size_t len) {
+  int seq;
+
+  // Still full from a failed write: no room until it succeeds
+  if (pending.count == BATCH_SIZE) {
+    int err = write_pending();
+
+    if (err) {
+      return err;
+    }
+  }
+
+  if (pending.count == 0) {
+    pending.first_seq = next_seq;
+  }
+
+  struct bps_record* record = &pending.records[pending.count++];
+
+  record->len = len;
+  memcpy(record->data, data, len);
+  seq = next_seq++;
+  stats.appended++;
+
+  if (pending.count == BATCH_SIZE) {
+    // Kept and retried on failure, the record is in RAM meanwhile
+    write_pending();
+  } else if (CONFIG_APP_RECORD_STORE_FLUSH_TIMEOUT_MS > 0) {
+    k_work_schedule(&flush_work,
+                    K_MSEC(CONFIG_APP_RECORD_STORE_FLUSH_TIMEOUT_MS));
+  }
+
+  return seq;
+}
+
+int record_store_flush(void) {
+  int err = 0;
+
+  k_mutex_lock(&store_lock, K_FOREVER);
+  size_t slot = slot_of(pending.first_seq);
+
+  // Written already unless records were added since the last flush
+  if (pending.count > 0 && (slot_first_seq[slot] != pending.first_seq ||
+                            slot_count[slot] != pending.count)) {
+    err = write_pending();
+  }
+  k_mutex_unlock(&store_lock);
+  return err;
+}
+
+static void flush_work_fn(struct k_work* work) {
+  ARG_UNUSED(work);
+  record_store_flush();
+}
+
+// Walk the flash slots oldest first, then the RAM batch. Slots whose index
+// rules out the filter are not read.
+static int foreach_filtered(uint32_t from_seq,
+                            const struct record_filter* filter,
+                            record_store_cb cb, void* user_data) {
+  struct slot_index index;
+  int err = 0;
+
+  if (!atomic_get(&loaded)) {
+    return -EAGAIN;
+  }
+
+  k_mutex_lock(&store_lock, K_FOREVER);
+
+  size_t start = slot_of(next_seq);
+
+  for (size_t i = 0; i < BATCH_COUNT; i++) {
+    size_t slot = (start + i) % BATCH_COUNT;
+    uint32_t first = slot_first_seq[slot];
+
+    if (first == 0 || first + slot_count[slot] <= from_seq ||
+        (pending.count > 0 && first == pending.first_seq) ||
+        !index_match(&slot_index[slot], filter)) {
+      continue;
+    }
+
+    err = load_slot(slot, &scratch);
+    stats.batches_read++;
+    if (err || scratch.first_seq != first) {
+      LOG_WRN("Batch %u unreadable (err %d)", first, err);
+      continue;
+    }
+
+    for (uint8_t j = 0; j < scratch.count; j++) {
+      uint32_t seq = scratch.first_seq + j;
+
+      if (seq >= from_seq && record_match(&scratch.records[j], filter) &&
+          !cb(seq, &scratch.records[j], user_data)) {
+        goto out;
+      }
+    }
+  }
+
+  // Not indexed while it fills, but in RAM anyway
+  index_batch(&pending, &index);
+  if (!index_match(&index, filter)) {
+    goto out;
+  }
+
+  for (uint8_t j = 0; j < pending.count; j++) {
+    uint32_t seq = pending.first_seq + j;
+
+    if (seq >= from_seq && record_match(&pending.records[j], filter) &&
+        !cb(seq, &pending.records[j], user_data)) {
+      break;
+    }
+  }
+
+out:
+  k_mutex_unlock(&store_lock);
+  return err;
+}
+
+int record_store_foreach(uint32_t from_seq, record_store_cb cb,
+                         void* user_data) {
+  return foreach_filtered(from_seq, NULL, cb, user_data);
+}
+
+int record_store_foreach_user(uint8_t user, uint32_t since,
+                              record_store_cb cb, void* user_data) {
+  const struct record_filter filter = {.user = user, .since = since};
+
+  return foreach_filtered(0, &filter, cb, user_data);
+}
+
+static bool modify_batch(struct record_batch* batch, uint32_t from_seq,
+                         uint32_t to_seq, record_store_modify_cb cb,
+                         void* user_data) {
+  bool changed = false;
+
+  for (uint8_t j = 0; j < batch->count; j++) {
+    uint32_t seq = batch->first_seq + j;
+
+    if (seq >= from_seq && seq <= to_seq &&
+        cb(seq, &batch->records[j], user_data)) {
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+int record_store_modify(uint32_t from_seq, uint32_t to_seq,
+                        record_store_modify_cb cb, void* user_data) {
+  int err = 0;
+
+  if (!atomic_get(&loaded)) {
+    return -EAGAIN;
+  }
+
+  k_mutex_lock(&store_lock, K_FOREVER);
+
+  // Oldest first, as foreach_filtered(): once the log wrapped, slot order is
+  // not sequence order
+  size_t start = slot_of(next_seq);
+
+  for (size_t i = 0; i < BATCH_COUNT; i++) {
+    size_t slot = (start + i) % BATCH_COUNT;
+    uint32_t first = slot_first_seq[slot];
+
+    if (first == 0 || first + slot_count[slot] <= from_seq || first > to_seq ||
+        (pending.count > 0 && first == pending.first_seq)) {
+      continue;
+    }
+
+    if (load_slot(slot, &scratch) || scratch.first_seq != first) {
+      LOG_WRN("Batch %u unreadable", first);
+      continue;
+    }
+
+    if (modify_batch(&scratch, from_seq, to_seq, cb, user_data)) {
+      err = write_batch(&scratch) ?: err;
+    }
+  }
+
+  // Goes out with the batch, unless a flush already wrote part of it
+  if (pending.count > 0 &&
+      modify_batch(&pending, from_seq, to_seq, cb, user_data) &&
+      slot_first_seq[slot_of(pending.first_seq)] == pending.first_seq) {
+    err = write_batch(&pending) ?: err;
+  }
+
+  k_mutex_unlock(&store_lock);
+  return err;
+}
+
+uint32_t record_store_count(uint32_t from_seq) {
+  uint32_t count = 0;
+
+  if (!atomic_get(&loaded)) {
+    return 0;
+  }
+
+  k_mutex_lock(&store_lock, K_FOREVER);
+
+  for (size_t slot = 0; slot < BATCH_COUNT; slot++) {
+    uint32_t first = MAX(slot_first_seq[slot], from_seq);
+    uint32_t end = slot_first_seq[slot] + slot_count[slot];
+
+    if (slot_first_seq[slot] == 0 ||
+        (pending.count > 0 && slot_first_seq[slot] == pending.first_seq)) {
+      continue;
+    }
+    if (end > first) {
+      count += end - first;
+    }
+  }
+
+  if (pending.count > 0) {
+    uint32_t first = MAX(pending.first_seq, from_seq);
+    uint32_t end = pending.first_seq + pending.count;
+
+    if (end > first) {
+      count += end - first;
+    }
+  }
+
+  k_mutex_unlock(&store_lock);
+  return count;
+}
+
+uint32_t record_store_last_seq(void) {
+  uint32_t last;
+
+  k_mutex_lock(&store_lock, K_FOREVER);
+  last = next_seq - 1;
+  k_mutex_unlock(&store_lock);
+  return last;
+}
+
+void record_store_get_stats(struct record_store_stats* out) {
+  k_mutex_lock(&store_lock, K_FOREVER);
+  *out = stats;
+  k_mutex_unlock(&store_lock);
+}
+
+size_t record_store_index_size(void) {
+  return sizeof(slot_first_seq) + sizeof(slot_count) + sizeof(slot_index);
+}
+
+#if IS_ENABLED(CONFIG_APP_RECORD_STORE_SHELL)
+static int cmd_records_index(const struct shell* sh, size_t argc,
+                             char** argv) {
+  uint32_t count = record_store_count(0);
+  size_t size = record_store_index_size();
+
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  shell_print(sh, "%u records in %u slots of %u, index %zu B in RAM", count,
+              BATCH_COUNT, BATCH_SIZE, size);
+  // The index is sized for a full log, this is what 1k records cost
+  shell_print(sh, "%zu B per 1k records",
+              size * 1000 / (BATCH_COUNT * BATCH_SIZE));
+  return 0;
+}
+
+static bool count_cb(uint32_t seq, const struct bps_record* record,
+                     void* user_data) {
+  ARG_UNUSED(seq);
+  ARG_UNUSED(record);
+  (*(uint32_t*)user_data)++;
+  return true;
+}
+
+static int cmd_records_query(const struct shell* sh, size_t argc,
+                             char** argv) {
+  uint8_t user = strtoul(argv[1], NULL, 0);
+  uint32_t since = (argc > 2) ? strtoul(argv[2], NULL, 0) : 0;
+  uint32_t matches = 0;
+  uint32_t read_before = stats.batches_read;
+  uint32_t start = k_cycle_get_32();
+  int err = record_store_foreach_user(user, since, count_cb, &matches);
+  uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+  if (err) {
+    shell_error(sh, "Query failed (err %d)", err);
+    return err;
+  }
+
+  shell_print(sh, "User %u since %u: %u records, %u of %u batches read, %u us",
+              user, since, matches, stats.batches_read - read_before,
+              BATCH_COUNT, us);
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    records_cmds,
+    SHELL_CMD(index, NULL, "Index size in RAM", cmd_records_index),
+    SHELL_CMD_ARG(query, NULL,
+                  "<user> [since]: records of a user, since a Unix time",
+                  cmd_records_query, 2, 1),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(records, &records_cmds, "Record store", NULL);
+#endif
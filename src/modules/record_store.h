@@ -0,0 +1,92 @@
+#ifndef ST_BLE_RECORD_STORE_H_
+#define ST_BLE_RECORD_STORE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/toolchain.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest Blood Pressure Measurement payload kept per record
+#define BPS_RECORD_MAX_LEN 21
+
+struct bps_record {
+  uint8_t len;
+  uint8_t data[BPS_RECORD_MAX_LEN];
+} __packed;
+
+struct record_store_stats {
+  // Records appended since boot
+  uint32_t appended;
+  // Batches and bytes handed to NVS since boot
+  uint32_t batches_written;
+  uint32_t bytes_written;
+  // Batches read back from flash by queries since boot
+  uint32_t batches_read;
+};
+
+// Called for each record in sequence order, return false to stop iterating
+typedef bool (*record_store_cb)(uint32_t seq, const struct bps_record* record,
+                                void* user_data);
+
+// Called for each record in a range in sequence order, may change it in
+// place. Return true if the record was changed.
+typedef bool (*record_store_modify_cb)(uint32_t seq, struct bps_record* record,
+                                       void* user_data);
+
+// Restore the sequence range from flash, call after settings subsystem init.
+// May run in the background: until it returns the store reads as empty and
+// appends are held in RAM, then stored in order.
+int record_store_init(void);
+
+// Append a measurement, returns its sequence number (>= 1) or negative errno.
+// Records are buffered in RAM and written out one batch at a time. Before
+// record_store_init() finished, returns 0: the record is queued and gets its
+// sequence number then, or -EAGAIN once CONFIG_APP_RECORD_STORE_EARLY_COUNT
+// records are waiting. A full batch that failed to write is kept in RAM and
+// retried; appends fail with its error until it is written.
+int record_store_append(const uint8_t* data, size_t len);
+
+// Sequence number of the index-th record queued before record_store_init()
+// finished, i.e. for which record_store_append() returned 0. Returns 0 while
+// it is still queued, negative errno if it was not stored.
+int record_store_early_seq(size_t index);
+
+// Write out the RAM batch even if it is not full
+int record_store_flush(void);
+
+// Iterate over stored records with seq >= from_seq
+int record_store_foreach(uint32_t from_seq, record_store_cb cb,
+                         void* user_data);
+
+// Let cb rewrite the stored records with from_seq <= seq <= to_seq. Each
+// batch with a changed record is written back once.
+int record_store_modify(uint32_t from_seq, uint32_t to_seq,
+                        record_store_modify_cb cb, void* user_data);
+
+// Iterate over the records of one user with a time stamp >= since, given in
+// seconds since 1970 (0: all of them). Uses the in-RAM index of the batches
+// in flash, batches without a match are not read.
+int record_store_foreach_user(uint8_t user, uint32_t since,
+                              record_store_cb cb, void* user_data);
+
+// Number of stored records with seq >= from_seq
+uint32_t record_store_count(uint32_t from_seq);
+
+// Sequence number of the newest record, 0 if none was ever appended
+uint32_t record_store_last_seq(void);
+
+void record_store_get_stats(struct record_store_stats* stats);
+
+// RAM used to locate records, the per-batch index included
+size_t record_store_index_size(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_RECORD_STORE_H_ */
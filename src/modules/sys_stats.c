@@ -0,0 +1,271 @@
+#include <zephyr/kernel.h>
+
+#define MODULE sys_stats
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_SYS_STATS_LOG_LEVEL);
+
+#include "modules/sys_stats.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/init.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/sys_heap.h>
+
+#define MAX_THREADS CONFIG_APP_SYS_STATS_MAX_THREADS
+
+#if CONFIG_HEAP_MEM_POOL_SIZE > 0
+extern struct k_heap _system_heap;
+#endif
+
+static struct sample {
+  struct sys_stats_thread threads[MAX_THREADS];
+  size_t thread_count;
+  struct sys_stats_heap heap;
+  uint16_t cpu_permille;
+  uint32_t period_ms;
+} latest;
+
+static struct k_spinlock lock;
+
+// Only touched by the sampler: cycle counts at the previous sample
+static struct {
+  k_tid_t tid[MAX_THREADS];
+  uint64_t cycles[MAX_THREADS];
+  size_t count;
+  uint64_t all_cycles;
+  uint64_t busy_cycles;
+  int64_t uptime_ms;
+} prev;
+
+// Threads already warned about, so a full stack logs once
+static k_tid_t warned[MAX_THREADS];
+
+struct walk {
+  struct sample* s;
+  k_tid_t tid[MAX_THREADS];
+  uint64_t cycles[MAX_THREADS];
+  uint64_t all_delta;
+  size_t skipped;
+};
+
+static void sample_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(sample_work, sample_work_fn);
+
+static uint64_t prev_cycles(k_tid_t tid) {
+  for (size_t i = 0; i < prev.count; i++) {
+    if (prev.tid[i] == tid) {
+      return prev.cycles[i];
+    }
+  }
+  return 0;
+}
+
+static void check_stack(k_tid_t tid, const struct sys_stats_thread* t) {
+  size_t free_slot = MAX_THREADS;
+
+  if (t->stack_used * 100 <
+      t->stack_size * CONFIG_APP_SYS_STATS_STACK_WARN_PCT) {
+    return;
+  }
+  for (size_t i = 0; i < MAX_THREADS; i++) {
+    if (warned[i] == tid) {
+      return;
+    }
+    if (warned[i] == NULL && free_slot == MAX_THREADS) {
+      free_slot = i;
+    }
+  }
+  if (free_slot < MAX_THREADS) {
+    warned[free_slot] = tid;
+  }
+  LOG_WRN("Thread %.*s uses %u of %u stack bytes", SYS_STATS_NAME_LEN,
+          t->name, t->stack_used, t->stack_size);
+}
+
+static void sample_thread(const struct k_thread* cthread, void* user_data) {
+  k_tid_t tid = (k_tid_t)cthread;
+  struct walk* w = user_data;
+  struct sys_stats_thread* t;
+  k_thread_runtime_stats_t rt;
+  const char* name = k_thread_name_get(tid);
+  size_t unused;
+  size_t n = w->s->thread_count;
+
+  if (n == MAX_THREADS) {
+    w->skipped++;
+    return;
+  }
+  t = &w->s->threads[n];
+
+  if (name != NULL && name[0] != '\0') {
+    strncpy(t->name, name, sizeof(t->name));
+  } else {
+    snprintf(t->name, sizeof(t->name), "%p", (void*)tid);
+  }
+
+  t->stack_size = cthread->stack_info.size;
+  if (k_thread_stack_space_get(tid, &unused) == 0) {
+    t->stack_used = t->stack_size - unused;
+  } else {
+    t->stack_used = 0;
+  }
+
+  w->tid[n] = tid;
+  w->cycles[n] = 0;
+  t->cpu_permille = 0;
+  if (k_thread_runtime_stats_get(tid, &rt) == 0) {
+    uint64_t delta = rt.execution_cycles - prev_cycles(tid);
+
+    w->cycles[n] = rt.execution_cycles;
+    if (w->all_delta != 0) {
+      t->cpu_permille = MIN(delta * 1000 / w->all_delta, 1000);
+    }
+  }
+
+  check_stack(tid, t);
+  w->s->thread_count++;
+}
+
+static void sample_heap(struct sys_stats_heap* heap) {
+  memset(heap, 0, sizeof(*heap));
+
+#if CONFIG_HEAP_MEM_POOL_SIZE > 0
+  struct sys_memory_stats stats;
+
+  if (sys_heap_runtime_stats_get(&_system_heap.heap, &stats) == 0) {
+    heap->size = stats.free_bytes + stats.allocated_bytes;
+    heap->used = stats.allocated_bytes;
+    heap->max_used = stats.max_allocated_bytes;
+  }
+#endif
+}
+
+static void sample_work_fn(struct k_work* work) {
+  // Off the workqueue stack
+  static struct walk w;
+  static struct sample s;
+  k_thread_runtime_stats_t all;
+  int64_t now = k_uptime_get();
+  k_spinlock_key_t key;
+
+  k_thread_runtime_stats_all_get(&all);
+
+  memset(&s, 0, sizeof(s));
+  memset(&w, 0, sizeof(w));
+  w.s = &s;
+  // Nothing to compare with on the first run, shares stay at 0
+  if (prev.uptime_ms != 0) {
+    w.all_delta = all.execution_cycles - prev.all_cycles;
+    s.period_ms = now - prev.uptime_ms;
+  }
+  if (w.all_delta != 0) {
+    s.cpu_permille =
+        MIN((all.total_cycles - prev.busy_cycles) * 1000 / w.all_delta, 1000);
+  }
+
+  // Unlocked: the stack scan is slow and the sampler creates no threads
+  k_thread_foreach_unlocked(sample_thread, &w);
+  if (w.skipped != 0) {
+    LOG_WRN("%zu threads over CONFIG_APP_SYS_STATS_MAX_THREADS", w.skipped);
+  }
+  sample_heap(&s.heap);
+
+  memcpy(prev.tid, w.tid, sizeof(prev.tid));
+  memcpy(prev.cycles, w.cycles, sizeof(prev.cycles));
+  prev.count = s.thread_count;
+  prev.all_cycles = all.execution_cycles;
+  prev.busy_cycles = all.total_cycles;
+  prev.uptime_ms = now;
+
+  key = k_spin_lock(&lock);
+  latest = s;
+  k_spin_unlock(&lock, key);
+
+  LOG_DBG("%zu threads, cpu %u permille, heap %u/%u", s.thread_count,
+          s.cpu_permille, s.heap.used, s.heap.size);
+
+  k_work_reschedule(&sample_work, K_MSEC(CONFIG_APP_SYS_STATS_PERIOD_MS));
+}
+
+size_t sys_stats_threads(struct sys_stats_thread* out, size_t max) {
+  k_spinlock_key_t key = k_spin_lock(&lock);
+  size_t n = MIN(max, latest.thread_count);
+
+  memcpy(out, latest.threads, n * sizeof(*out));
+  k_spin_unlock(&lock, key);
+  return n;
+}
+
+void sys_stats_heap(struct sys_stats_heap* out) {
+  k_spinlock_key_t key = k_spin_lock(&lock);
+
+  *out = latest.heap;
+  k_spin_unlock(&lock, key);
+}
+
+uint16_t sys_stats_cpu_load(void) {
+  k_spinlock_key_t key = k_spin_lock(&lock);
+  uint16_t load = latest.cpu_permille;
+
+  k_spin_unlock(&lock, key);
+  return load;
+}
+
+uint32_t sys_stats_period_ms(void) {
+  k_spinlock_key_t key = k_spin_lock(&lock);
+  uint32_t period = latest.period_ms;
+
+  k_spin_unlock(&lock, key);
+  return period;
+}
+
+static int sys_stats_init(void) {
+  // First sample right away for the stack sizes, shares from the second
+  k_work_schedule(&sample_work, K_NO_WAIT);
+  return 0;
+}
+
+SYS_INIT(sys_stats_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if IS_ENABLED(CONFIG_APP_SYS_STATS_SHELL)
+static int cmd_stats_show(const struct shell* sh, size_t argc, char** argv) {
+  static struct sys_stats_thread threads[MAX_THREADS];
+  struct sys_stats_heap heap;
+  size_t n = sys_stats_threads(threads, ARRAY_SIZE(threads));
+  uint16_t load = sys_stats_cpu_load();
+
+  sys_stats_heap(&heap);
+
+  shell_print(sh, "cpu %u.%u%% over %u ms, heap %u/%u bytes (max %u)",
+              load / 10, load % 10, sys_stats_period_ms(), heap.used,
+              heap.size, heap.max_used);
+  shell_print(sh, "%-12s %11s %5s %6s", "thread", "stack", "%", "cpu");
+  for (size_t i = 0; i < n; i++) {
+    const struct sys_stats_thread* t = &threads[i];
+
+    shell_print(sh, "%-12.*s %5u/%-5u %4u%% %3u.%u%%", SYS_STATS_NAME_LEN,
+                t->name, t->stack_used, t->stack_size,
+                t->stack_size ? t->stack_used * 100 / t->stack_size : 0,
+                t->cpu_permille / 10, t->cpu_permille % 10);
+  }
+  return 0;
+}
+
+static int cmd_stats_sample(const struct shell* sh, size_t argc, char** argv) {
+  k_work_reschedule(&sample_work, K_NO_WAIT);
+  shell_print(sh, "Sampling");
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    stats_cmds,
+    SHELL_CMD(show, NULL, "Stack, heap and CPU use at the last sample",
+              cmd_stats_show),
+    SHELL_CMD(sample, NULL, "Sample now, ends the current period",
+              cmd_stats_sample),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(stats, &stats_cmds, "System statistics", NULL);
+#endif
@@ -0,0 +1,47 @@
+#ifndef ST_BLE_SYS_STATS_H_
+#define ST_BLE_SYS_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_STATS_NAME_LEN 12
+
+struct sys_stats_thread {
+  // Truncated, not terminated when it fills the array
+  char name[SYS_STATS_NAME_LEN];
+  uint32_t stack_size;
+  // High-water mark since boot
+  uint32_t stack_used;
+  // Share of the cycles of the last period, in 0.1 %
+  uint16_t cpu_permille;
+};
+
+struct sys_stats_heap {
+  uint32_t size;
+  uint32_t used;
+  // High-water mark since boot
+  uint32_t max_used;
+};
+
+#if IS_ENABLED(CONFIG_APP_SYS_STATS)
+// Copy of the latest sample, threads in creation order. Returns the number
+// of threads copied, at most max.
+size_t sys_stats_threads(struct sys_stats_thread* out, size_t max);
+void sys_stats_heap(struct sys_stats_heap* out);
+// Non idle share of the cycles of the last period, in 0.1 %
+uint16_t sys_stats_cpu_load(void);
+// Milliseconds covered by the latest sample, 0 before the first one
+uint32_t sys_stats_period_ms(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_SYS_STATS_H_ */
@@ -0,0 +1,149 @@
+#include <zephyr/kernel.h>
+
+#define MODULE trace
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_TRACE_LOG_LEVEL);
+
+#include "modules/trace.h"
+
+#include <string.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/util.h>
+
+#define RING_SIZE CONFIG_APP_TRACE_RING_SIZE
+
+BUILD_ASSERT(TRACE_STAGE_COUNT <= ATOMIC_BITS, "One armed bit per stage");
+
+static const struct {
+  const char* name;
+  enum trace_path path;
+} stage_info[TRACE_STAGE_COUNT] = {
+    [TRACE_CLICK] = {"click", TRACE_PATH_BUTTON},
+    [TRACE_STATUS_POSTED] = {"status_posted", TRACE_PATH_BUTTON},
+    [TRACE_DISPATCH] = {"dispatch", TRACE_PATH_BUTTON},
+    [TRACE_ADV_APPLIED] = {"adv_applied", TRACE_PATH_BUTTON},
+    [TRACE_ENQUEUE] = {"enqueue", TRACE_PATH_NOTIFY},
+    [TRACE_TX_HANDOFF] = {"tx_handoff", TRACE_PATH_NOTIFY},
+    [TRACE_TX_COMPLETE] = {"tx_complete", TRACE_PATH_NOTIFY},
+};
+
+// Cycle counter at the start of the current run of each path
+static atomic_t path_start[TRACE_PATH_COUNT];
+// Stages not yet reached in the current runs
+static atomic_t armed;
+
+// Latest samples per stage, in us since the start of the path
+static struct stage_ring {
+  atomic_t count;
+  uint32_t us[RING_SIZE];
+} rings[TRACE_STAGE_COUNT];
+
+// Sort buffer of trace_get_stats(), too large for the callers' stacks
+static uint32_t sorted[RING_SIZE];
+static K_MUTEX_DEFINE(sorted_lock);
+
+void trace_begin(enum trace_path path) {
+  atomic_set(&path_start[path], (atomic_val_t)k_cycle_get_32());
+
+  for (size_t i = 0; i < TRACE_STAGE_COUNT; i++) {
+    if (stage_info[i].path == path) {
+      atomic_set_bit(&armed, i);
+    }
+  }
+}
+
+void trace_stage(enum trace_stage stage) {
+  uint32_t now = k_cycle_get_32();
+  struct stage_ring* ring = &rings[stage];
+  uint32_t start;
+
+  // Only the first time per run, e.g. the first of a burst of notifications
+  if (!atomic_test_and_clear_bit(&armed, stage)) {
+    return;
+  }
+
+  start = (uint32_t)atomic_get(&path_start[stage_info[stage].path]);
+  ring->us[atomic_inc(&ring->count) % RING_SIZE] =
+      k_cyc_to_us_floor32(now - start);
+}
+
+void trace_get_stats(enum trace_stage stage, struct trace_stats* out) {
+  const struct stage_ring* ring = &rings[stage];
+  uint32_t count = (uint32_t)atomic_get(&ring->count);
+  size_t n = MIN(count, RING_SIZE);
+  uint64_t sum = 0;
+
+  memset(out, 0, sizeof(*out));
+  out->count = count;
+  if (n == 0) {
+    return;
+  }
+
+  k_mutex_lock(&sorted_lock, K_FOREVER);
+
+  // Insertion sort, the ring is small and this is not on the hot path
+  for (size_t i = 0; i < n; i++) {
+    uint32_t us = ring->us[i];
+    size_t j = i;
+
+    sum += us;
+    for (; j > 0 && sorted[j - 1] > us; j--) {
+      sorted[j] = sorted[j - 1];
+    }
+    sorted[j] = us;
+  }
+
+  out->min_us = sorted[0];
+  out->max_us = sorted[n - 1];
+  out->avg_us = sum / n;
+  out->p99_us = sorted[DIV_ROUND_UP(n * 99, 100) - 1];
+  k_mutex_unlock(&sorted_lock);
+}
+
+const char* trace_stage_name(enum trace_stage stage) {
+  return stage_info[stage].name;
+}
+
+void trace_reset(void) {
+  atomic_clear(&armed);
+  for (size_t i = 0; i < TRACE_STAGE_COUNT; i++) {
+    atomic_clear(&rings[i].count);
+  }
+}
+
+#if IS_ENABLED(CONFIG_APP_TRACE_SHELL)
+static int cmd_trace_show(const struct shell* sh, size_t argc, char** argv) {
+  struct trace_stats s;
+
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  shell_print(sh, "%-14s %8s %8s %8s %8s %8s", "stage", "count", "min_us",
+              "avg_us", "max_us", "p99_us");
+  for (size_t i = 0; i < TRACE_STAGE_COUNT; i++) {
+    trace_get_stats(i, &s);
+    shell_print(sh, "%-14s %8u %8u %8u %8u %8u", trace_stage_name(i), s.count,
+                s.min_us, s.avg_us, s.max_us, s.p99_us);
+  }
+  return 0;
+}
+
+static int cmd_trace_reset(const struct shell* sh, size_t argc, char** argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  trace_reset();
+  shell_print(sh, "Trace reset");
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    trace_cmds,
+    SHELL_CMD(show, NULL, "Per stage latency since the start of its path",
+              cmd_trace_show),
+    SHELL_CMD(reset, NULL, "Clear all samples", cmd_trace_reset),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(trace, &trace_cmds, "Hot path latency tracing", NULL);
+#endif
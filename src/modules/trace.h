@@ -0,0 +1,63 @@
+#ifndef ST_BLE_TRACE_H_
+#define ST_BLE_TRACE_H_
+
+#include <stdint.h>
+
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Traced paths, each starts with trace_begin()
+enum trace_path {
+  // Button press to the advertising change
+  TRACE_PATH_BUTTON,
+  // BPM CCC write to the first notification reaching the controller
+  TRACE_PATH_NOTIFY,
+
+  TRACE_PATH_COUNT
+};
+
+// Stages record the time since the start of their path, once per run
+enum trace_stage {
+  // TRACE_PATH_BUTTON
+  TRACE_CLICK,
+  TRACE_STATUS_POSTED,
+  TRACE_DISPATCH,
+  TRACE_ADV_APPLIED,
+  // TRACE_PATH_NOTIFY
+  TRACE_ENQUEUE,
+  TRACE_TX_HANDOFF,
+  TRACE_TX_COMPLETE,
+
+  TRACE_STAGE_COUNT
+};
+
+struct trace_stats {
+  // Runs that reached the stage, the rest is over the last samples only
+  uint32_t count;
+  uint32_t min_us;
+  uint32_t avg_us;
+  uint32_t max_us;
+  uint32_t p99_us;
+};
+
+#if IS_ENABLED(CONFIG_APP_TRACE)
+// Both callable from any context, ISR included
+void trace_begin(enum trace_path path);
+void trace_stage(enum trace_stage stage);
+
+void trace_get_stats(enum trace_stage stage, struct trace_stats* stats);
+const char* trace_stage_name(enum trace_stage stage);
+void trace_reset(void);
+#else
+static inline void trace_begin(enum trace_path path) {}
+static inline void trace_stage(enum trace_stage stage) {}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_TRACE_H_ */
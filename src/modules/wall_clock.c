@@ -0,0 +1,218 @@
+#include <zephyr/kernel.h>
+
+#define MODULE wall_clock
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(MODULE, CONFIG_APP_WALL_CLOCK_LOG_LEVEL);
+
+#include "app_work.h"
+#include "modules/wall_clock.h"
+
+#include <time.h>
+#include <bluetooth/gatt_dm.h>
+#include <bluetooth/services/cts_client.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/sys/timeutil.h>
+
+// Unix time in ms at uptime 0. Stamps are taken as plain uptime, turning one
+// into a date is a single add plus gmtime_r() when it is encoded.
+static struct k_spinlock clock_lock;
+static int64_t offset_ms;
+static bool synced;
+
+static wall_clock_sync_cb sync_cb;
+
+// One central at a time provides the time, the others are not asked
+static struct bt_cts_client cts_c;
+static atomic_ptr_t cts_conn;
+
+static void on_synced(const struct app_work_event* evt) {
+  ARG_UNUSED(evt);
+
+  if (sync_cb) {
+    sync_cb();
+  }
+}
+
+// The Current Time characteristic holds local time. It is handled as UTC
+// both ways, so the time stamps come out in the central's local time as the
+// Date Time format expects.
+static void apply_time(const struct bt_cts_exact_time_256* t) {
+  const struct app_work_event evt = {.type = APP_WORK_TIME_SYNCED};
+  struct tm tm = {
+      .tm_year = t->year - 1900,
+      .tm_mon = t->month - 1,
+      .tm_mday = t->day,
+      .tm_hour = t->hours,
+      .tm_min = t->minutes,
+      .tm_sec = t->seconds,
+  };
+  int64_t unix_ms, delta_ms;
+  bool first;
+
+  if (t->year == 0 || t->month == 0 || t->day == 0) {
+    LOG_WRN("Central does not know the time");
+    return;
+  }
+
+  unix_ms = timeutil_timegm64(&tm) * 1000 + t->fractions256 * 1000 / 256;
+
+  k_spinlock_key_t key = k_spin_lock(&clock_lock);
+
+  delta_ms = unix_ms - k_uptime_get() - offset_ms;
+  offset_ms += delta_ms;
+  first = !synced;
+  synced = true;
+  k_spin_unlock(&clock_lock, key);
+
+  if (first) {
+    LOG_INF("Time %04u-%02u-%02u %02u:%02u:%02u", t->year, t->month, t->day,
+            t->hours, t->minutes, t->seconds);
+    app_work_submit(on_synced, &evt);
+  } else {
+    LOG_INF("Clock corrected by %lld ms", delta_ms);
+  }
+}
+
+static void cts_read_cb(struct bt_cts_client* cts,
+                        struct bt_cts_current_time* current_time, int err) {
+  ARG_UNUSED(cts);
+
+  if (err) {
+    LOG_WRN("Current Time read failed (err %d)", err);
+    return;
+  }
+  apply_time(&current_time->exact_time_256);
+}
+
+// The central changed its clock, e.g. time zone or a manual update
+static void cts_notify_cb(struct bt_cts_client* cts,
+                          struct bt_cts_current_time* current_time) {
+  ARG_UNUSED(cts);
+  apply_time(&current_time->exact_time_256);
+}
+
+static void discovery_completed(struct bt_gatt_dm* dm, void* context) {
+  int err;
+
+  ARG_UNUSED(context);
+
+  err = bt_cts_handles_assign(dm, &cts_c);
+  bt_gatt_dm_data_release(dm);
+  if (err) {
+    LOG_WRN("Current Time Service unusable (err %d)", err);
+    atomic_ptr_clear(&cts_conn);
+    return;
+  }
+
+  err = bt_cts_read_current_time(&cts_c, cts_read_cb);
+  if (err) {
+    LOG_WRN("Cannot read Current Time (err %d)", err);
+  }
+
+  // Optional in CTS, the central may not support it
+  err = bt_cts_subscribe_current_time(&cts_c, cts_notify_cb);
+  if (err) {
+    LOG_DBG("No Current Time notifications (err %d)", err);
+  }
+}
+
+static void discovery_service_not_found(struct bt_conn* conn, void* context) {
+  ARG_UNUSED(conn);
+  ARG_UNUSED(context);
+
+  LOG_INF("Central has no Current Time Service");
+  atomic_ptr_clear(&cts_conn);
+}
+
+static void discovery_error_found(struct bt_conn* conn, int err,
+                                  void* context) {
+  ARG_UNUSED(conn);
+  ARG_UNUSED(context);
+
+  LOG_WRN("Current Time Service discovery failed (err %d)", err);
+  atomic_ptr_clear(&cts_conn);
+}
+
+static const struct bt_gatt_dm_cb discovery_cb = {
+    .completed = discovery_completed,
+    .service_not_found = discovery_service_not_found,
+    .error_found = discovery_error_found,
+};
+
+static void on_cts_discover(const struct app_work_event* evt) {
+  int err;
+
+  if (!atomic_ptr_cas(&cts_conn, NULL, evt->conn)) {
+    return;
+  }
+
+  bt_cts_client_init(&cts_c);
+  err = bt_gatt_dm_start(evt->conn, BT_UUID_CTS, &discovery_cb, NULL);
+  if (err) {
+    LOG_WRN("Cannot discover Current Time Service (err %d)", err);
+    atomic_ptr_clear(&cts_conn);
+  }
+}
+
+// CTS needs an encrypted link. Any paired central gets this far, bonded or
+// not: pairing without bonding also reaches L2.
+static void security_changed(struct bt_conn* conn, bt_security_t level,
+                             enum bt_security_err err) {
+  const struct app_work_event evt = {.type = APP_WORK_CTS_DISCOVER,
+                                     .conn = conn};
+
+  if (err || level < BT_SECURITY_L2) {
+    return;
+  }
+
+  app_work_submit(on_cts_discover, &evt);
+}
+
+static void disconnected(struct bt_conn* conn, uint8_t reason) {
+  ARG_UNUSED(reason);
+  atomic_ptr_cas(&cts_conn, conn, NULL);
+}
+
+BT_CONN_CB_DEFINE(wall_clock_conn_callbacks) = {
+    .disconnected = disconnected,
+    .security_changed = security_changed,
+};
+
+void wall_clock_init(wall_clock_sync_cb cb) {
+  sync_cb = cb;
+}
+
+bool wall_clock_synced(void) {
+  k_spinlock_key_t key = k_spin_lock(&clock_lock);
+  bool ret = synced;
+
+  k_spin_unlock(&clock_lock, key);
+  return ret;
+}
+
+int wall_clock_to_bpm_time(int64_t uptime_ms, struct bpm_time* t) {
+  k_spinlock_key_t key = k_spin_lock(&clock_lock);
+  int64_t unix_ms = uptime_ms + offset_ms;
+  bool valid = synced;
+
+  k_spin_unlock(&clock_lock, key);
+
+  if (!valid) {
+    memset(t, 0, sizeof(*t));
+    return -EAGAIN;
+  }
+
+  time_t secs = (time_t)(unix_ms / 1000);
+  struct tm tm;
+
+  gmtime_r(&secs, &tm);
+  t->year = tm.tm_year + 1900;
+  t->month = tm.tm_mon + 1;
+  t->day = tm.tm_mday;
+  t->hours = tm.tm_hour;
+  t->minutes = tm.tm_min;
+  t->seconds = tm.tm_sec;
+  return 0;
+}
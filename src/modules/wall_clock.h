@@ -0,0 +1,44 @@
+#ifndef ST_BLE_WALL_CLOCK_H_
+#define ST_BLE_WALL_CLOCK_H_
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zephyr/sys/util.h>
+
+#include "bpm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Called on the application work queue once the clock is first synced
+typedef void (*wall_clock_sync_cb)(void);
+
+#if IS_ENABLED(CONFIG_APP_WALL_CLOCK)
+void wall_clock_init(wall_clock_sync_cb cb);
+
+bool wall_clock_synced(void);
+
+// Date and time at an uptime stamp (k_uptime_get()). Returns -EAGAIN and a
+// zero, i.e. unknown, time until the clock is synced.
+int wall_clock_to_bpm_time(int64_t uptime_ms, struct bpm_time* t);
+#else
+static inline void wall_clock_init(wall_clock_sync_cb cb) {}
+static inline bool wall_clock_synced(void) {
+  return false;
+}
+static inline int wall_clock_to_bpm_time(int64_t uptime_ms,
+                                         struct bpm_time* t) {
+  memset(t, 0, sizeof(*t));
+  return -EAGAIN;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ST_BLE_WALL_CLOCK_H_ */
@@ -0,0 +1,131 @@
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/ztest.h>
+
+// The static state is reset to simulate a reboot
+#include "app_state.c"
+
+// Long enough for the pending write to happen
+#define QUIET K_MSEC(CONFIG_APP_STATE_SAVE_DELAY_MS + 10)
+
+static const struct stored_state defaults = {
+    .adv_enabled = 1,
+};
+
+static void make_peer(uint8_t n, bt_addr_le_t* addr) {
+  *addr = (bt_addr_le_t){
+      .type = BT_ADDR_LE_RANDOM,
+      .a.val = {n, 0x01, 0x02, 0x03, 0x04, 0xc0},
+  };
+}
+
+// What a reboot leaves: flash only
+static void reboot(void) {
+  struct k_work_sync sync;
+
+  k_work_cancel_delayable_sync(&save_work, &sync);
+  state = defaults;
+  saved = defaults;
+  dirty_since = 0;
+  memset(&stats, 0, sizeof(stats));
+  zassert_ok(settings_load_subtree(APP_STATE_SUBTREE));
+}
+
+static void before(void* fixture) {
+  ARG_UNUSED(fixture);
+
+  zassert_ok(settings_subsys_init());
+  settings_delete(APP_STATE_SUBTREE);
+  reboot();
+}
+
+// A burst of changes costs one write, of the last state
+ZTEST(app_state, test_burst) {
+  const uint32_t n = 100;
+  struct app_state_stats s;
+  struct app_state st;
+  bt_addr_le_t addr;
+
+  for (uint32_t i = 0; i < n; i++) {
+    make_peer(i, &addr);
+    app_state_set_last_peer(&addr);
+    app_state_set_adv_enabled(i % 2);
+  }
+  app_state_get_stats(&s);
+  zassert_equal(s.updates, 2 * n);
+  zassert_equal(s.writes, 0, "written before the quiet period");
+
+  k_sleep(QUIET);
+  app_state_get_stats(&s);
+  zassert_equal(s.writes, 1);
+
+  reboot();
+  app_state_get(&st);
+  zassert_true(bt_addr_le_eq(&st.last_peer, &addr));
+  zassert_equal(st.adv_enabled, (n - 1) % 2);
+}
+
+// Setting the same value again is no change
+ZTEST(app_state, test_same_value) {
+  struct app_state_stats s;
+
+  for (int i = 0; i < 10; i++) {
+    app_state_set_adv_enabled(true);
+  }
+  k_sleep(QUIET);
+  app_state_get_stats(&s);
+  zassert_equal(s.updates, 0);
+  zassert_equal(s.writes, 0);
+}
+
+// A change undone within the quiet period is not written
+ZTEST(app_state, test_undone) {
+  struct app_state_stats s;
+
+  app_state_set_adv_enabled(false);
+  app_state_set_adv_enabled(true);
+  k_sleep(QUIET);
+  app_state_get_stats(&s);
+  zassert_equal(s.updates, 2);
+  zassert_equal(s.writes, 0);
+  zassert_equal(s.unchanged, 1);
+}
+
+// Changes that keep coming are still written within the max delay
+ZTEST(app_state, test_max_delay) {
+  const uint32_t n = 2 * CONFIG_APP_STATE_SAVE_MAX_DELAY_MS /
+                     (CONFIG_APP_STATE_SAVE_DELAY_MS / 2);
+  struct app_state_stats s;
+  bt_addr_le_t addr;
+
+  for (uint32_t i = 0; i < n; i++) {
+    make_peer(i, &addr);
+    app_state_set_last_peer(&addr);
+    k_msleep(CONFIG_APP_STATE_SAVE_DELAY_MS / 2);
+  }
+  app_state_get_stats(&s);
+  zassert_true(s.writes >= 1, "no write within the max delay");
+  zassert_true(s.writes < n, "%u writes for %u changes", s.writes, n);
+}
+
+ZTEST(app_state, test_flush) {
+  struct app_state_stats s;
+  struct app_state st;
+
+  app_state_set_adv_enabled(false);
+  zassert_ok(app_state_flush());
+  app_state_get_stats(&s);
+  zassert_equal(s.writes, 1);
+  zassert_false(k_work_delayable_is_pending(&save_work));
+
+  // Nothing left to write
+  zassert_ok(app_state_flush());
+  app_state_get_stats(&s);
+  zassert_equal(s.writes, 1);
+
+  reboot();
+  app_state_get(&st);
+  zassert_false(st.adv_enabled);
+}
+
+ZTEST_SUITE(app_state, NULL, NULL, before, NULL, NULL);
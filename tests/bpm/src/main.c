@@ -0,0 +1,170 @@
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include "bpm.h"
+
+// Every field present: flags, then the fields in BLS 3.1.1 order
+#define FULL_LEN 19
+
+// 120/80 mmHg, mean arterial 93
+static const uint8_t pressures[] = {0x78, 0x00, 0x50, 0x00, 0x5d, 0x00};
+// 2024-03-15 08:30:45
+static const uint8_t time_stamp[] = {0xe8, 0x07, 0x03, 0x0f, 0x08, 0x1e, 0x2d};
+// 72 bpm
+static const uint8_t pulse_rate[] = {0x48, 0x00};
+static const uint8_t user_id[] = {0x03};
+// Body movement and irregular pulse
+static const uint8_t status[] = {0x05, 0x00};
+
+static const struct bpm_measurement measurement = {
+    .systolic = SFLOAT(120, 0),
+    .diastolic = SFLOAT(80, 0),
+    .mean_arterial = SFLOAT(93, 0),
+    .time_stamp = {2024, 3, 15, 8, 30, 45},
+    .pulse_rate = SFLOAT(72, 0),
+    .user_id = 3,
+    .status = BPM_STATUS_BODY_MOVEMENT | BPM_STATUS_IRREGULAR_PULSE,
+};
+
+static void add(uint8_t* out, size_t* len, const uint8_t* field, size_t n) {
+  memcpy(&out[*len], field, n);
+  *len += n;
+}
+
+// The measurement above as the spec lays it out for these flags
+static size_t vector(uint8_t flags, uint8_t* out) {
+  size_t len = 0;
+
+  out[len++] = flags;
+  add(out, &len, pressures, sizeof(pressures));
+  if (flags & BPM_FLAG_TIME_STAMP) {
+    add(out, &len, time_stamp, sizeof(time_stamp));
+  }
+  if (flags & BPM_FLAG_PULSE_RATE) {
+    add(out, &len, pulse_rate, sizeof(pulse_rate));
+  }
+  if (flags & BPM_FLAG_USER_ID) {
+    add(out, &len, user_id, sizeof(user_id));
+  }
+  if (flags & BPM_FLAG_STATUS) {
+    add(out, &len, status, sizeof(status));
+  }
+  return len;
+}
+
+ZTEST(bpm, test_encode) {
+  NET_BUF_SIMPLE_DEFINE(buf, FULL_LEN);
+  uint8_t expected[FULL_LEN];
+  size_t len = vector(BPM_FLAGS, expected);
+
+  zassert_equal(BPM_ENCODED_LEN, len);
+  zassert_equal(bpm_encode(&measurement, &buf), len);
+  zassert_equal(buf.len, len);
+  zassert_mem_equal(buf.data, expected, len, "flags 0x%02x", BPM_FLAGS);
+}
+
+ZTEST(bpm, test_encode_no_room) {
+  NET_BUF_SIMPLE_DEFINE(buf, BPM_ENCODED_LEN - 1);
+
+  zassert_equal(bpm_encode(&measurement, &buf), -ENOMEM);
+  zassert_equal(buf.len, 0);
+}
+
+// Any layout decodes, whatever this build encodes
+ZTEST(bpm, test_decode_all_flags) {
+  for (uint8_t flags = 0; flags < 32; flags++) {
+    uint8_t data[FULL_LEN];
+    size_t len = vector(flags, data);
+    struct bpm_measurement m;
+
+    memset(&m, 0xaa, sizeof(m));
+    zassert_equal(bpm_decode(data, len, &m), flags);
+    zassert_equal(m.systolic, measurement.systolic);
+    zassert_equal(m.diastolic, measurement.diastolic);
+    zassert_equal(m.mean_arterial, measurement.mean_arterial);
+
+    if (flags & BPM_FLAG_TIME_STAMP) {
+      zassert_mem_equal(&m.time_stamp, &measurement.time_stamp,
+                        sizeof(m.time_stamp), "flags 0x%02x", flags);
+    } else {
+      zassert_equal(m.time_stamp.year, 0);
+      zassert_equal(m.time_stamp.seconds, 0);
+    }
+    zassert_equal(m.pulse_rate, (flags & BPM_FLAG_PULSE_RATE)
+                                    ? measurement.pulse_rate
+                                    : 0);
+    zassert_equal(m.user_id,
+                  (flags & BPM_FLAG_USER_ID) ? measurement.user_id : 0);
+    zassert_equal(m.status,
+                  (flags & BPM_FLAG_STATUS) ? measurement.status : 0);
+    zassert_equal(m.taken_at, 0);
+  }
+}
+
+ZTEST(bpm, test_decode_truncated) {
+  struct bpm_measurement m;
+
+  zassert_equal(bpm_decode(NULL, 0, &m), -EINVAL);
+
+  for (uint8_t flags = 0; flags < 32; flags++) {
+    uint8_t data[FULL_LEN + 1] = {0};
+    size_t len = vector(flags, data);
+
+    for (size_t cut = 1; cut < len; cut++) {
+      zassert_equal(bpm_decode(data, cut, &m), -EINVAL,
+                    "flags 0x%02x, %zu of %zu bytes", flags, cut, len);
+    }
+    zassert_equal(bpm_decode(data, len + 1, &m), -EINVAL);
+  }
+}
+
+// Special values (IEEE 11073-20601 SFLOAT) pass through unchanged
+ZTEST(bpm, test_sfloat_special) {
+  static const sfloat_t values[] = {SFLOAT_NAN, SFLOAT_NRES, SFLOAT_POS_INF,
+                                    SFLOAT_NEG_INF};
+  static const uint8_t bytes[][2] = {
+      {0xff, 0x07}, {0x00, 0x08}, {0xfe, 0x07}, {0x02, 0x08}};
+
+  for (size_t i = 0; i < ARRAY_SIZE(values); i++) {
+    NET_BUF_SIMPLE_DEFINE(buf, FULL_LEN);
+    struct bpm_measurement m = measurement;
+    struct bpm_measurement decoded;
+
+    m.systolic = values[i];
+    m.diastolic = values[i];
+    m.mean_arterial = values[i];
+    m.pulse_rate = values[i];
+
+    zassert_equal(bpm_encode(&m, &buf), BPM_ENCODED_LEN);
+    for (size_t field = 0; field < 3; field++) {
+      zassert_mem_equal(&buf.data[1 + 2 * field], bytes[i], 2,
+                        "value 0x%04x", values[i]);
+    }
+
+    zassert_equal(bpm_decode(buf.data, buf.len, &decoded), BPM_FLAGS);
+    zassert_equal(decoded.systolic, values[i]);
+    zassert_equal(decoded.diastolic, values[i]);
+    zassert_equal(decoded.mean_arterial, values[i]);
+    if (BPM_FLAGS & BPM_FLAG_PULSE_RATE) {
+      zassert_equal(decoded.pulse_rate, values[i]);
+    }
+  }
+}
+
+ZTEST(bpm, test_set_time_stamp) {
+  static const struct bpm_time t = {2025, 12, 31, 23, 59, 58};
+  static const uint8_t t_bytes[] = {0xe9, 0x07, 0x0c, 0x1f, 0x17, 0x3b, 0x3a};
+  uint8_t data[FULL_LEN];
+  size_t len = vector(BPM_FLAG_TIME_STAMP | BPM_FLAG_USER_ID, data);
+
+  zassert_ok(bpm_set_time_stamp(data, len, &t));
+  zassert_mem_equal(&data[BPM_TIME_STAMP_OFFSET], t_bytes, sizeof(t_bytes));
+  zassert_equal(data[len - 1], user_id[0], "User ID overwritten");
+
+  len = vector(BPM_FLAG_USER_ID, data);
+  zassert_equal(bpm_set_time_stamp(data, len, &t), -EINVAL);
+}
+
+ZTEST_SUITE(bpm, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,203 @@
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+// The static state is reset to simulate a reboot
+#include "modules/record_store.c"
+
+#define RECORDS_MAX (BATCH_SIZE * BATCH_COUNT)
+
+struct walk {
+  uint32_t seqs[RECORDS_MAX + BATCH_SIZE];
+  size_t count;
+  // Records whose content does not match their seq
+  size_t bad;
+};
+
+// A BPM without optional fields, the seq as the systolic pressure
+static void make_record(uint32_t seq, uint8_t* data) {
+  memset(data, 0, 7);
+  sys_put_le16(SFLOAT(seq & 0x3ff, 0), &data[1]);
+}
+
+static void append(uint32_t n) {
+  uint8_t data[7];
+
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t seq = record_store_last_seq() + 1;
+
+    make_record(seq, data);
+    zassert_equal(record_store_append(data, sizeof(data)), seq);
+  }
+}
+
+// Asserts can't return from here, the results are checked by the caller
+static bool walk_cb(uint32_t seq, const struct bps_record* record,
+                    void* user_data) {
+  struct walk* walk = user_data;
+  uint8_t data[7];
+
+  make_record(seq, data);
+  if (record->len != sizeof(data) || memcmp(record->data, data, 7) != 0) {
+    walk->bad++;
+  }
+  if (walk->count == ARRAY_SIZE(walk->seqs)) {
+    return false;
+  }
+  walk->seqs[walk->count++] = seq;
+  return true;
+}
+
+// All stored records, in sequence order and from first to last
+static void check_range(uint32_t first, uint32_t last) {
+  struct walk walk = {0};
+
+  zassert_ok(record_store_foreach(0, walk_cb, &walk));
+  zassert_equal(walk.bad, 0, "%zu records changed", walk.bad);
+  zassert_equal(walk.count, last - first + 1, "%zu records", walk.count);
+  for (size_t i = 0; i < walk.count; i++) {
+    zassert_equal(walk.seqs[i], first + i);
+  }
+  zassert_equal(record_store_count(0), last - first + 1);
+  zassert_equal(record_store_last_seq(), last);
+}
+
+// What a reboot leaves: flash only
+static void forget(void) {
+  memset(slot_first_seq, 0, sizeof(slot_first_seq));
+  memset(slot_count, 0, sizeof(slot_count));
+  memset(slot_index, 0, sizeof(slot_index));
+  memset(&pending, 0, sizeof(pending));
+  memset(&stats, 0, sizeof(stats));
+  next_seq = 1;
+  early_stored = 0;
+  atomic_clear(&loaded);
+}
+
+static void reboot(void) {
+  forget();
+  zassert_ok(record_store_init());
+}
+
+static void erase(void) {
+  for (size_t slot = 0; slot < BATCH_COUNT; slot++) {
+    nvs_delete(nvs, BATCH_ID(slot));
+    nvs_delete(nvs, INDEX_ID(slot));
+  }
+}
+
+static void before(void* fixture) {
+  ARG_UNUSED(fixture);
+
+  zassert_ok(settings_subsys_init());
+  zassert_ok(settings_storage_get((void**)&nvs));
+  erase();
+  reboot();
+}
+
+ZTEST(record_store, test_append) {
+  struct record_store_stats s;
+
+  zassert_equal(record_store_count(0), 0);
+  zassert_equal(record_store_last_seq(), 0);
+
+  append(BATCH_SIZE - 1);
+  record_store_get_stats(&s);
+  zassert_equal(s.batches_written, 0, "partial batch written");
+  check_range(1, BATCH_SIZE - 1);
+
+  append(1);
+  record_store_get_stats(&s);
+  zassert_equal(s.batches_written, 1);
+  check_range(1, BATCH_SIZE);
+
+  zassert_equal(record_store_count(3), BATCH_SIZE - 2);
+  zassert_equal(record_store_append(NULL, 0), -EINVAL);
+}
+
+ZTEST(record_store, test_wrap) {
+  // One batch more than fits, the first one is dropped
+  append(RECORDS_MAX + BATCH_SIZE);
+  check_range(BATCH_SIZE + 1, RECORDS_MAX + BATCH_SIZE);
+
+  // The RAM batch fills the slot of the oldest flash batch
+  append(2);
+  check_range(BATCH_SIZE + 1, RECORDS_MAX + BATCH_SIZE + 2);
+}
+
+ZTEST(record_store, test_reload) {
+  append(2 * BATCH_SIZE + 1);
+  zassert_ok(record_store_flush());
+
+  reboot();
+  check_range(1, 2 * BATCH_SIZE + 1);
+
+  // The flushed partial batch keeps filling
+  zassert_equal(pending.count, 1);
+  append(BATCH_SIZE - 1);
+  reboot();
+  check_range(1, 3 * BATCH_SIZE);
+}
+
+ZTEST(record_store, test_reload_wrapped) {
+  append(RECORDS_MAX + 2 * BATCH_SIZE);
+
+  reboot();
+  check_range(2 * BATCH_SIZE + 1, RECORDS_MAX + 2 * BATCH_SIZE);
+
+  append(1);
+  zassert_equal(record_store_last_seq(), RECORDS_MAX + 2 * BATCH_SIZE + 1);
+}
+
+static bool modify_cb(uint32_t seq, struct bps_record* record,
+                      void* user_data) {
+  struct walk* walk = user_data;
+
+  ARG_UNUSED(record);
+  if (walk->count < ARRAY_SIZE(walk->seqs)) {
+    walk->seqs[walk->count++] = seq;
+  }
+  return false;
+}
+
+// Callers such as the back-dating in bps_svc.c rely on sequence order
+ZTEST(record_store, test_modify_wrapped) {
+  uint32_t first = 2 * BATCH_SIZE + 1;
+  uint32_t last = RECORDS_MAX + 2 * BATCH_SIZE + 1;
+  struct walk walk = {0};
+
+  append(last);
+  zassert_ok(record_store_modify(0, UINT32_MAX, modify_cb, &walk));
+
+  zassert_equal(walk.count, last - first + 1, "%zu records", walk.count);
+  for (size_t i = 0; i < walk.count; i++) {
+    zassert_equal(walk.seqs[i], first + i);
+  }
+}
+
+// Appends made while the log is still being scanned are kept, in order
+ZTEST(record_store, test_append_before_load) {
+  uint8_t data[7];
+
+  append(3);
+  zassert_ok(record_store_flush());
+  forget();
+
+  for (uint32_t seq = 4; seq < 4 + EARLY_COUNT; seq++) {
+    make_record(seq, data);
+    zassert_equal(record_store_append(data, sizeof(data)), 0);
+  }
+  zassert_equal(record_store_append(data, sizeof(data)), -EAGAIN);
+  zassert_equal(record_store_count(0), 0);
+  zassert_equal(record_store_early_seq(0), 0);
+
+  zassert_ok(record_store_init());
+  check_range(1, 3 + EARLY_COUNT);
+  for (size_t i = 0; i < EARLY_COUNT; i++) {
+    zassert_equal(record_store_early_seq(i), 4 + i);
+  }
+  zassert_equal(record_store_early_seq(EARLY_COUNT), -ENOENT);
+}
+
+ZTEST_SUITE(record_store, NULL, NULL, before, NULL, NULL);